@@ -0,0 +1,96 @@
+#include "arena.h"
+#include <stdlib.h>
+
+#define ARENA_CHUNK_SIZE 4096
+
+static inline size_t
+_align(size_t size);
+
+static inline struct arena_chunk *
+_chunk_new(size_t size);
+
+// INTERNAL IMPLEMENTATION
+
+static inline size_t
+_align(size_t size)
+{
+    size_t align = _Alignof(max_align_t);
+    return (size + align - 1) & ~(align - 1);
+}
+
+static inline struct arena_chunk *
+_chunk_new(size_t size)
+{
+    struct arena_chunk *chunk = malloc(sizeof(struct arena_chunk) + size);
+    if (chunk == NULL)
+        return NULL;
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+// EXTERNAL / PUBLIC FUNCTIONS
+
+void
+arena_init(struct arena *arena, size_t chunk_size)
+{
+    arena->head = NULL;
+    arena->cur = NULL;
+    arena->chunk_size = chunk_size ? _align(chunk_size) : ARENA_CHUNK_SIZE;
+}
+
+void *
+arena_alloc(struct arena *arena, size_t size)
+{
+    size = _align(size);
+
+    // Use up the chunks kept by arena_reset before asking the heap for more
+    struct arena_chunk *chunk = arena->cur;
+    while (chunk != NULL && chunk->size - chunk->used < size) {
+        chunk = chunk->next;
+        if (chunk != NULL)
+            chunk->used = 0;
+    }
+
+    if (chunk == NULL) {
+        chunk = _chunk_new(size > arena->chunk_size ? size : arena->chunk_size);
+        if (chunk == NULL)
+            return NULL;
+        if (arena->cur == NULL) {
+            arena->head = chunk;
+        } else {
+            // Past the end of the list, so cur is the last chunk
+            struct arena_chunk *last = arena->cur;
+            while (last->next != NULL)
+                last = last->next;
+            last->next = chunk;
+        }
+    }
+
+    arena->cur = chunk;
+    void *ret = (char *)chunk->data + chunk->used;
+    chunk->used += size;
+    return ret;
+}
+
+void
+arena_reset(struct arena *arena)
+{
+    arena->cur = arena->head;
+    if (arena->cur != NULL)
+        arena->cur->used = 0;
+}
+
+void
+arena_destroy(struct arena *arena)
+{
+    struct arena_chunk *chunk = arena->head;
+    while (chunk != NULL) {
+        struct arena_chunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena->head = NULL;
+    arena->cur = NULL;
+}
@@ -0,0 +1,57 @@
+#ifndef SOLITAIRE_ARENA_H_
+#define SOLITAIRE_ARENA_H_
+
+#include <stddef.h>
+
+/*
+ * Bump allocator over a list of heap chunks. Nothing is freed on its own;
+ * arena_reset hands every chunk out again from the start, so once an arena
+ * has grown to fit a workload, running it again touches the heap no more.
+ */
+struct arena_chunk {
+    struct arena_chunk *next;
+    size_t size;
+    size_t used;
+    max_align_t data[];
+};
+
+struct arena {
+    struct arena_chunk *head;
+    struct arena_chunk *cur;
+    size_t chunk_size;
+};
+
+/**
+ * arena_init - Set up an empty arena.
+ * @arena: struct arena * to set up
+ * @chunk_size: bytes to take from the heap at a time, or 0 for a default
+ *
+ * Nothing is allocated until the first arena_alloc.
+ */
+void
+arena_init(struct arena *arena, size_t chunk_size);
+
+/**
+ * arena_alloc - Allocate from an arena.
+ * @arena: struct arena * to allocate from
+ * @size: bytes to allocate
+ *
+ * The memory is aligned for any type and stays valid until the arena is reset
+ * or destroyed. Returns NULL if the heap is out of memory.
+ */
+void *
+arena_alloc(struct arena *arena, size_t size);
+
+/**
+ * arena_reset - Free everything allocated from an arena at once.
+ * @arena: struct arena * to reset
+ *
+ * Keeps the chunks for the allocations to come.
+ */
+void
+arena_reset(struct arena *arena);
+
+void
+arena_destroy(struct arena *arena);
+
+#endif // SOLITAIRE_ARENA_H_
@@ -0,0 +1,221 @@
+#include "batch.h"
+#include "game.h"
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Work stealing deque of seed indices. All work is known up front, so a deque
+ * is the range [top, bottom) of indices still to solve. The owner pops from the
+ * bottom and thieves take from the top.
+ */
+struct batch_deque {
+    pthread_mutex_t lock;
+    uint64_t top;
+    uint64_t bottom;
+};
+
+struct batch_ctx {
+    struct batch_opts *opts;
+    struct batch_result *results;
+    struct batch_deque *deques;
+};
+
+struct batch_worker {
+    pthread_t thread;
+    int id;
+    struct batch_ctx *ctx;
+};
+
+static inline double
+_now(void);
+
+static inline bool
+_deque_pop(struct batch_deque *deque, uint64_t *idx);
+
+static inline bool
+_deque_steal(struct batch_deque *deque, uint64_t *top, uint64_t *bottom);
+
+static inline void
+_deque_refill(struct batch_deque *deque, uint64_t top, uint64_t bottom);
+
+static inline bool
+_batch_steal(struct batch_worker *worker);
+
+static inline void
+_batch_solve(
+    struct batch_worker *worker,
+    struct solver *solver,
+    struct field *field,
+    uint64_t idx
+    );
+
+static void *
+_batch_worker(void *arg);
+
+// INTERNAL IMPLEMENTATION
+
+static inline double
+_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static inline bool
+_deque_pop(struct batch_deque *deque, uint64_t *idx)
+{
+    bool ret = false;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->top < deque->bottom) {
+        *idx = --deque->bottom;
+        ret = true;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return ret;
+}
+
+// Takes the older half of the deque, rounded up
+static inline bool
+_deque_steal(struct batch_deque *deque, uint64_t *top, uint64_t *bottom)
+{
+    bool ret = false;
+    pthread_mutex_lock(&deque->lock);
+    uint64_t cnt = deque->bottom - deque->top;
+    if (cnt > 0) {
+        *top = deque->top;
+        deque->top += (cnt + 1) / 2;
+        *bottom = deque->top;
+        ret = true;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return ret;
+}
+
+static inline void
+_deque_refill(struct batch_deque *deque, uint64_t top, uint64_t bottom)
+{
+    pthread_mutex_lock(&deque->lock);
+    assert(deque->top == deque->bottom);
+    deque->top = top;
+    deque->bottom = bottom;
+    pthread_mutex_unlock(&deque->lock);
+}
+
+// Tries every other worker once, returning false when none had work left.
+// Work never grows, so that means the batch is done.
+static inline bool
+_batch_steal(struct batch_worker *worker)
+{
+    struct batch_ctx *ctx = worker->ctx;
+    int threads = ctx->opts->threads;
+    uint64_t top;
+    uint64_t bottom;
+    int i;
+    for (i = 1; i < threads; ++i) {
+        int victim = (worker->id + i) % threads;
+        if (_deque_steal(&ctx->deques[victim], &top, &bottom)) {
+            _deque_refill(&ctx->deques[worker->id], top, bottom);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Deals into the worker's field, so solving does not touch the heap
+static inline void
+_batch_solve(
+    struct batch_worker *worker,
+    struct solver *solver,
+    struct field *field,
+    uint64_t idx
+    )
+{
+    struct batch_result *result = &worker->ctx->results[idx];
+    double start = _now();
+
+    result->seed = worker->ctx->opts->first + idx;
+    field_reset(field, result->seed);
+    result->result = solver_run(solver, field);
+    result->nodes = solver->nodes;
+    result->seconds = _now() - start;
+}
+
+static void *
+_batch_worker(void *arg)
+{
+    struct batch_worker *worker = arg;
+    struct batch_deque *own = &worker->ctx->deques[worker->id];
+    struct solver solver;
+    struct deck deck = { 0 };
+    struct field field;
+    uint64_t idx;
+
+    solver_init(&solver, &worker->ctx->opts->solver);
+    deck_init_seeded(&deck, worker->ctx->opts->first);
+    field_init(&field, &deck);
+    do {
+        while (_deque_pop(own, &idx))
+            _batch_solve(worker, &solver, &field, idx);
+    } while (_batch_steal(worker));
+    field_destroy(&field);
+    deck_destroy(&deck);
+    solver_destroy(&solver);
+    return NULL;
+}
+
+// EXTERNAL / PUBLIC FUNCTIONS
+
+int
+batch_run(struct batch_opts *opts, struct batch_result *results)
+{
+    assert(opts->last >= opts->first);
+    assert(opts->last - opts->first < UINT64_MAX);
+    if (opts->threads < 1)
+        opts->threads = 1;
+
+    int threads = opts->threads;
+    uint64_t cnt = opts->last - opts->first + 1;
+    struct batch_ctx ctx = { opts, results, NULL };
+    struct batch_worker *workers = calloc((size_t)threads, sizeof(*workers));
+    ctx.deques = calloc((size_t)threads, sizeof(struct batch_deque));
+    if (workers == NULL || ctx.deques == NULL)
+        die("calloc");
+
+    // Hand every thread an even share of the range to start with
+    int i;
+    for (i = 0; i < threads; ++i) {
+        pthread_mutex_init(&ctx.deques[i].lock, NULL);
+        ctx.deques[i].top = cnt * (uint64_t)i / (uint64_t)threads;
+        ctx.deques[i].bottom = cnt * (uint64_t)(i + 1) / (uint64_t)threads;
+        workers[i].id = i;
+        workers[i].ctx = &ctx;
+    }
+
+    int err = 0;
+    int started;
+    for (started = 0; started < threads; ++started) {
+        err = pthread_create(&workers[started].thread, NULL,
+            _batch_worker, &workers[started]);
+        if (err != 0)
+            break;
+    }
+
+    // If some threads failed to start, the ones running steal their work
+    for (i = 0; i < started; ++i)
+        pthread_join(workers[i].thread, NULL);
+    if (started == 0)
+        err = err ? err : EAGAIN;
+    else
+        err = 0;
+
+    for (i = 0; i < threads; ++i)
+        pthread_mutex_destroy(&ctx.deques[i].lock);
+    free(ctx.deques);
+    free(workers);
+    return err;
+}
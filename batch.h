@@ -0,0 +1,37 @@
+#ifndef SOLITAIRE_BATCH_H_
+#define SOLITAIRE_BATCH_H_
+
+#include "solver.h"
+#include <stdint.h>
+
+struct batch_opts {
+    uint64_t first;             // First seed to solve
+    uint64_t last;              // Last seed to solve, inclusive
+    int threads;                // Number of worker threads
+    struct solver_opts solver;  // Options for every worker's solver
+};
+
+struct batch_result {
+    uint64_t seed;
+    uint64_t nodes;
+    double seconds;
+    enum solve_result result;
+};
+
+/**
+ * batch_run - Solve every deal in a range of seeds on a pool of threads.
+ * @opts: struct batch_opts * describing the range and the solver
+ * @results: struct batch_result * with room for last - first + 1 results
+ *
+ * Each worker owns a deque of seeds, initially an even share of the range. A
+ * worker takes seeds from the bottom of its own deque and, once it runs dry,
+ * steals the older half of another worker's deque from the top, so a few hard
+ * deals do not leave the other threads idle. results[i] is always the deal of
+ * seed first + i, whichever thread solved it.
+ *
+ * Returns 0 on success or an errno value if the threads could not be started.
+ */
+int
+batch_run(struct batch_opts *opts, struct batch_result *results);
+
+#endif // SOLITAIRE_BATCH_H_
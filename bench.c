@@ -0,0 +1,582 @@
+#include "card_type.h"
+#include "game.h"
+#include "debug.h"
+#include "deal.h"
+#include "counters.h"
+#include "render.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Micro benchmarks of the engine. Each prints one line:
+ *
+ *     <name> <ops> ops <ns> ns/op <rate> ops/s <allocs> allocs/op
+ *
+ * Allocations are counted by wrapping malloc, calloc and realloc at link time,
+ * see BENCH_LDFLAGS in the Makefile. Every benchmark runs on fixed deals, so
+ * runs can be compared across engine changes.
+ *
+ * With -c, hardware counters are read around the same timed parts and each
+ * line goes on with "<count> <counter>/op" for every counter, or
+ * "- <counter>/op" for counters the machine does not offer. Reading them
+ * costs system calls, which inflate ns/op, so compare timings from runs
+ * without -c.
+ */
+
+#define BENCH_SEED 1
+#define BENCH_DEALS_CHUNK 1024
+
+// Enough deals and undos to go through the whole stock and recycle it
+#define BENCH_STOCK_CYCLE (STOCK_CAP + 1)
+
+struct bench {
+    char const *name;
+    void (*run)(struct bench *bench, uint64_t ops);
+    uint64_t ops;       // Operations run at scale 1
+};
+
+// A running total over the timed parts of a benchmark
+struct bench_timer {
+    double start;
+    uint64_t allocs;
+    struct counters_sample counts;
+    double seconds;
+    uint64_t allocs_total;
+    uint64_t counts_total[COUNTER_MAX];
+};
+
+void *
+__real_malloc(size_t size);
+
+void *
+__real_calloc(size_t nmemb, size_t size);
+
+void *
+__real_realloc(void *ptr, size_t size);
+
+static inline double
+_now(void);
+
+static inline void
+_timer_start(struct bench_timer *timer);
+
+static inline void
+_timer_stop(struct bench_timer *timer);
+
+static void
+_report(struct bench *bench, uint64_t ops, struct bench_timer *timer);
+
+static void
+_field_crafted(struct field *field, struct deck *deck, int stack);
+
+static void
+_bench_deal_gen_bulk(struct bench *bench, uint64_t ops);
+
+static void
+_bench_deal_permute(struct bench *bench, uint64_t ops);
+
+static void
+_bench_deck_init(struct bench *bench, uint64_t ops);
+
+static void
+_bench_field_init(struct bench *bench, uint64_t ops);
+
+static void
+_bench_field_reset(struct bench *bench, uint64_t ops);
+
+static void
+_bench_deal_card_undo_move(struct bench *bench, uint64_t ops);
+
+static void
+_bench_move_single(struct bench *bench, uint64_t ops);
+
+static void
+_bench_move_stack(struct bench *bench, uint64_t ops);
+
+static void
+_bench_field_gen_moves(struct bench *bench, uint64_t ops);
+
+static void
+_bench_dead_end_check(struct bench *bench, uint64_t ops);
+
+static void
+_bench_field_sym_print(struct bench *bench, uint64_t ops);
+
+static void
+_bench_render_screen_diff(struct bench *bench, uint64_t ops);
+
+static uint64_t _allocs;
+
+// Open hardware counters, or NULL when not asked for
+static struct counters *_counters;
+
+// Keeps the compiler from dropping work whose result is never read
+static volatile uint64_t _sink;
+
+static struct bench _benches[] = {
+    { "deal_gen_bulk", _bench_deal_gen_bulk, 1 << 20 },
+    { "deal_permute", _bench_deal_permute, 1 << 20 },
+    { "deck_init", _bench_deck_init, 1 << 20 },
+    { "field_init", _bench_field_init, 1 << 20 },
+    { "field_reset", _bench_field_reset, 1 << 20 },
+    { "deal_card", _bench_deal_card_undo_move, 1 << 22 },
+    { "undo_move", NULL, 0 },     // Run along with deal_card
+    { "move_single", _bench_move_single, 1 << 22 },
+    { "move_stack", _bench_move_stack, 1 << 22 },
+    { "field_gen_moves", _bench_field_gen_moves, 1 << 20 },
+    { "dead_end_check", _bench_dead_end_check, 1 << 20 },
+    { "field_sym_print", _bench_field_sym_print, 1 << 16 },
+    { "render_screen_diff", _bench_render_screen_diff, 1 << 18 },
+};
+
+// ALLOCATION COUNTING
+
+void *
+__wrap_malloc(size_t size)
+{
+    _allocs++;
+    return __real_malloc(size);
+}
+
+void *
+__wrap_calloc(size_t nmemb, size_t size)
+{
+    _allocs++;
+    return __real_calloc(nmemb, size);
+}
+
+void *
+__wrap_realloc(void *ptr, size_t size)
+{
+    _allocs++;
+    return __real_realloc(ptr, size);
+}
+
+// INTERNAL IMPLEMENTATION
+
+static inline double
+_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static inline void
+_timer_start(struct bench_timer *timer)
+{
+    timer->allocs = _allocs;
+    if (_counters != NULL)
+        counters_read(_counters, &timer->counts);
+    timer->start = _now();
+}
+
+static inline void
+_timer_stop(struct bench_timer *timer)
+{
+    timer->seconds += _now() - timer->start;
+    if (_counters != NULL) {
+        struct counters_sample end;
+        counters_read(_counters, &end);
+        int i;
+        // Scaling can make a count go back a little, take that as none
+        for (i = 0; i < COUNTER_MAX; ++i)
+            if (end.values[i] > timer->counts.values[i])
+                timer->counts_total[i] += end.values[i]
+                    - timer->counts.values[i];
+    }
+    timer->allocs_total += _allocs - timer->allocs;
+}
+
+static void
+_report(struct bench *bench, uint64_t ops, struct bench_timer *timer)
+{
+    printf("%-20s %12llu ops %10.1f ns/op %14.0f ops/s %8.3f allocs/op",
+        bench->name,
+        (unsigned long long)ops,
+        timer->seconds * 1e9 / (double)ops,
+        (double)ops / timer->seconds,
+        (double)timer->allocs_total / (double)ops);
+
+    int i;
+    for (i = 0; _counters != NULL && i < COUNTER_MAX; ++i) {
+        if (counters_available(_counters, i))
+            printf(" %10.2f", (double)timer->counts_total[i] / (double)ops);
+        else
+            printf(" %10s", "-");
+        printf(" %s/op", counter_str(i));
+    }
+    printf("\n");
+}
+
+/*
+ * A king on tableau 0, with a queen and a jack on it when stack is set, and
+ * tableau 1 empty, so the king can go back and forth between them. The other
+ * cards fill the stock and, face down, tableaus 2 to 6.
+ */
+static void
+_field_crafted(struct field *field, struct deck *deck, int stack)
+{
+    uint8_t top[] = {
+        card_id(&(struct card){ .suit = SUIT_SPADE, .rank = RANK_K }),
+        card_id(&(struct card){ .suit = SUIT_HEART, .rank = RANK_Q }),
+        card_id(&(struct card){ .suit = SUIT_SPADE, .rank = RANK_J }),
+    };
+    int tab0 = stack ? 3 : 1;
+    struct field_pack pack = { 0 };
+    int n = 0;
+    int id;
+    int i;
+
+    // Stock first, then tableau 0, then the face down rest
+    for (id = 0; id < SOLITAIRE_DECK_SIZE && n < STOCK_CAP; ++id)
+        if (memchr(top, id, sizeof(top)) == NULL)
+            pack.cards[n++] = (uint8_t)id;
+    for (i = 0; i < tab0; ++i)
+        pack.cards[n++] = top[i] | FIELD_PACK_FACE_UP;
+    for (; id < SOLITAIRE_DECK_SIZE; ++id)
+        if (memchr(top, id, sizeof(top)) == NULL)
+            pack.cards[n++] = (uint8_t)id;
+    for (i = tab0; i < 3; ++i)
+        pack.cards[n++] = top[i];
+
+    int rest = SOLITAIRE_DECK_SIZE - STOCK_CAP - tab0;
+    pack.lens[LOC_STOCK - LOC_STOCK] = STOCK_CAP;
+    pack.lens[LOC_TAB0 - LOC_STOCK] = (uint8_t)tab0;
+    for (i = LOC_TAB2; i < LOC_TAB6; ++i)
+        pack.lens[i - LOC_STOCK] = (uint8_t)(rest / 5);
+    pack.lens[LOC_TAB6 - LOC_STOCK] = (uint8_t)(rest - 4 * (rest / 5));
+
+    deck_init_seeded(deck, BENCH_SEED);
+    if (!field_unpack(field, deck, &pack))
+        die("field_unpack");
+}
+
+static void
+_bench_deal_gen_bulk(struct bench *bench, uint64_t ops)
+{
+    uint8_t *buf = malloc(BENCH_DEALS_CHUNK * SOLITAIRE_DECK_SIZE);
+    struct bench_timer timer = { 0 };
+    uint64_t done;
+    if (buf == NULL)
+        die("malloc");
+
+    _timer_start(&timer);
+    for (done = 0; done < ops; done += BENCH_DEALS_CHUNK) {
+        deal_gen_bulk(buf, done, BENCH_DEALS_CHUNK);
+        _sink ^= buf[done % BENCH_DEALS_CHUNK];
+    }
+    _timer_stop(&timer);
+    _report(bench, done, &timer);
+    free(buf);
+}
+
+static void
+_bench_deal_permute(struct bench *bench, uint64_t ops)
+{
+    uint8_t perm[SOLITAIRE_DECK_SIZE];
+    struct bench_timer timer = { 0 };
+    uint64_t i;
+
+    _timer_start(&timer);
+    for (i = 0; i < ops; ++i) {
+        deal_permute(i, perm);
+        _sink ^= perm[i % SOLITAIRE_DECK_SIZE];
+    }
+    _timer_stop(&timer);
+    _report(bench, ops, &timer);
+}
+
+// Includes deck_destroy, since every deck_init needs one
+static void
+_bench_deck_init(struct bench *bench, uint64_t ops)
+{
+    struct bench_timer timer = { 0 };
+    uint64_t i;
+
+    _timer_start(&timer);
+    for (i = 0; i < ops; ++i) {
+        struct deck deck = { 0 };
+        deck_init_seeded(&deck, BENCH_SEED + i);
+        _sink ^= deck.cards[i % SOLITAIRE_DECK_SIZE].rank;
+        deck_destroy(&deck);
+    }
+    _timer_stop(&timer);
+    _report(bench, ops, &timer);
+}
+
+// Includes field_destroy. field_init empties the deck, so its length is put
+// back each time.
+static void
+_bench_field_init(struct bench *bench, uint64_t ops)
+{
+    struct bench_timer timer = { 0 };
+    struct deck deck = { 0 };
+    struct field field;
+    uint64_t i;
+
+    deck_init_seeded(&deck, BENCH_SEED);
+    _timer_start(&timer);
+    for (i = 0; i < ops; ++i) {
+        deck.len = SOLITAIRE_DECK_SIZE;
+        field_init(&field, &deck);
+        _sink ^= field_hash(&field);
+        field_destroy(&field);
+    }
+    _timer_stop(&timer);
+    _report(bench, ops, &timer);
+    deck_destroy(&deck);
+}
+
+// A new deal every time, in the same storage
+static void
+_bench_field_reset(struct bench *bench, uint64_t ops)
+{
+    struct bench_timer timer = { 0 };
+    struct deck deck = { 0 };
+    struct field field;
+    uint64_t i;
+
+    deck_init_seeded(&deck, BENCH_SEED);
+    field_init(&field, &deck);
+    _timer_start(&timer);
+    for (i = 0; i < ops; ++i) {
+        field_reset(&field, BENCH_SEED + i);
+        _sink ^= field_hash(&field);
+    }
+    _timer_stop(&timer);
+    _report(bench, ops, &timer);
+    field_destroy(&field);
+    deck_destroy(&deck);
+}
+
+// Deals through the whole stock, recycle included, then undoes it all, timing
+// deal_card and undo_move apart. Reports both.
+static void
+_bench_deal_card_undo_move(struct bench *bench, uint64_t ops)
+{
+    struct bench_timer deal = { 0 };
+    struct bench_timer undo = { 0 };
+    struct deck deck = { 0 };
+    struct field field;
+    uint64_t done;
+    int i;
+
+    deck_init_seeded(&deck, BENCH_SEED);
+    field_init(&field, &deck);
+    for (done = 0; done < ops; done += BENCH_STOCK_CYCLE) {
+        _timer_start(&deal);
+        for (i = 0; i < BENCH_STOCK_CYCLE; ++i)
+            deal_card(&field);
+        _timer_stop(&deal);
+
+        _timer_start(&undo);
+        for (i = 0; i < BENCH_STOCK_CYCLE; ++i)
+            undo_move(&field);
+        _timer_stop(&undo);
+    }
+    _sink ^= field_hash(&field);
+    _report(bench, done, &deal);
+    _report(bench + 1, done, &undo);
+    field_destroy(&field);
+    deck_destroy(&deck);
+}
+
+// A lone king back and forth between two tableaus
+static void
+_bench_move_single(struct bench *bench, uint64_t ops)
+{
+    struct bench_timer timer = { 0 };
+    struct deck deck = { 0 };
+    struct field field;
+    uint64_t i;
+
+    _field_crafted(&field, &deck, 0);
+    struct card *king = pile_top_card(&field.tableaus[0]);
+    _timer_start(&timer);
+    for (i = 0; i < ops; ++i)
+        move_card_to_pile(king, &field.tableaus[(i + 1) & 1]);
+    _timer_stop(&timer);
+    _sink ^= field_hash(&field);
+    _report(bench, ops, &timer);
+    field_destroy(&field);
+    deck_destroy(&deck);
+}
+
+// A king with two cards on it back and forth between two tableaus
+static void
+_bench_move_stack(struct bench *bench, uint64_t ops)
+{
+    struct bench_timer timer = { 0 };
+    struct deck deck = { 0 };
+    struct field field;
+    uint64_t i;
+
+    _field_crafted(&field, &deck, 1);
+    struct card *king = pile_get_nth_card(&field.tableaus[0], 2);
+    _timer_start(&timer);
+    for (i = 0; i < ops; ++i)
+        move_card_to_pile(king, &field.tableaus[(i + 1) & 1]);
+    _timer_stop(&timer);
+    _sink ^= field_hash(&field);
+    _report(bench, ops, &timer);
+    field_destroy(&field);
+    deck_destroy(&deck);
+}
+
+static void
+_bench_field_gen_moves(struct bench *bench, uint64_t ops)
+{
+    struct card_move moves[FIELD_MAX_MOVES];
+    struct bench_timer timer = { 0 };
+    struct deck deck = { 0 };
+    struct field field;
+    uint64_t i;
+
+    deck_init_seeded(&deck, BENCH_SEED);
+    field_init(&field, &deck);
+    _timer_start(&timer);
+    for (i = 0; i < ops; ++i)
+        _sink += field_gen_moves(&field, moves, FIELD_MAX_MOVES);
+    _timer_stop(&timer);
+    _report(bench, ops, &timer);
+    field_destroy(&field);
+    deck_destroy(&deck);
+}
+
+// The check only looks again at piles that changed, so it runs after the king
+// of move_single changes tableaus, as in the game loop. Take move_single off
+// for the check alone.
+static void
+_bench_dead_end_check(struct bench *bench, uint64_t ops)
+{
+    struct bench_timer timer = { 0 };
+    struct deck deck = { 0 };
+    struct field field;
+    uint64_t i;
+
+    _field_crafted(&field, &deck, 0);
+    struct card *king = pile_top_card(&field.tableaus[0]);
+    _timer_start(&timer);
+    for (i = 0; i < ops; ++i) {
+        move_card_to_pile(king, &field.tableaus[(i + 1) & 1]);
+        _sink += dead_end_check(&field);
+    }
+    _timer_stop(&timer);
+    _report(bench, ops, &timer);
+    field_destroy(&field);
+    deck_destroy(&deck);
+}
+
+// Prints to /dev/null, and flushes before stopping the clock so the write is
+// counted too
+static void
+_bench_field_sym_print(struct bench *bench, uint64_t ops)
+{
+    struct bench_timer timer = { 0 };
+    struct deck deck = { 0 };
+    struct field field;
+    uint64_t i;
+
+    int null = open("/dev/null", O_WRONLY);
+    int out = dup(STDOUT_FILENO);
+    if (null < 0 || out < 0)
+        die("open");
+
+    deck_init_seeded(&deck, BENCH_SEED);
+    field_init(&field, &deck);
+    fflush(stdout);
+    dup2(null, STDOUT_FILENO);
+    _timer_start(&timer);
+    for (i = 0; i < ops; ++i)
+        field_sym_print(&field);
+    fflush(stdout);
+    _timer_stop(&timer);
+    dup2(out, STDOUT_FILENO);
+    close(out);
+    close(null);
+
+    _report(bench, ops, &timer);
+    field_destroy(&field);
+    deck_destroy(&deck);
+}
+
+// The redraw after each move_single move, written to /dev/null. Compare with
+// field_sym_print, which sends the whole board every time.
+static void
+_bench_render_screen_diff(struct bench *bench, uint64_t ops)
+{
+    struct render_screen screen;
+    struct bench_timer timer = { 0 };
+    struct deck deck = { 0 };
+    struct field field;
+    uint64_t i;
+
+    int null = open("/dev/null", O_WRONLY);
+    if (null < 0)
+        die("open");
+
+    _field_crafted(&field, &deck, 0);
+    struct card *king = pile_top_card(&field.tableaus[0]);
+    render_screen_init(&screen);
+    render_screen_diff(&screen, &field);
+    _timer_start(&timer);
+    for (i = 0; i < ops; ++i) {
+        move_card_to_pile(king, &field.tableaus[(i + 1) & 1]);
+        render_screen_diff(&screen, &field);
+        render_flush(&screen.out, null);
+    }
+    _timer_stop(&timer);
+    close(null);
+
+    _report(bench, ops, &timer);
+    field_destroy(&field);
+    deck_destroy(&deck);
+}
+
+// EXTERNAL / PUBLIC FUNCTIONS
+
+int
+main(int argc, char **argv)
+{
+    struct counters counters;
+    double scale = 1;
+    int c;
+
+    while ((c = getopt(argc, argv, "c")) != -1) {
+        switch (c) {
+            case 'c':
+                _counters = &counters;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-c] [scale]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (optind < argc)
+        scale = strtod(argv[optind], NULL);
+
+    if (_counters != NULL && counters_open(_counters) == 0)
+        fprintf(stderr, "No hardware counters: %s\n", strerror(errno));
+
+    size_t i;
+    for (i = 0; i < sizeof(_benches) / sizeof(_benches[0]); ++i) {
+        struct bench *bench = &_benches[i];
+        uint64_t ops = (uint64_t)((double)bench->ops * scale);
+        if (bench->run == NULL)
+            continue;
+        bench->run(bench, ops > 0 ? ops : 1);
+        fflush(stdout);
+    }
+
+    if (_counters != NULL)
+        counters_close(_counters);
+    return 0;
+}
@@ -1,11 +1,27 @@
 #ifndef SOLITAIRE_CARD_TYPE_H_
 #define SOLITAIRE_CARD_TYPE_H_
 
-#include "list.h"
 #include <stdbool.h>
+#include <stdint.h>
 
 #define NUM_TABLEAU 7
 #define NUM_FOUNDATION 4
+#define NUM_PILES (2 + NUM_TABLEAU + NUM_FOUNDATION)
+
+#define SOLITAIRE_DECK_SIZE (RANK_MAX * SUIT_MAX)
+
+// Pile capacities. The stock holds whatever is left after the tableaus are
+// dealt, a tableau can hold at most six face down cards plus a full King to
+// Ace run, and a foundation holds one suit.
+#define STOCK_CAP 24
+#define WASTE_CAP STOCK_CAP
+#define TABLEAU_CAP 19
+#define FOUNDATION_CAP RANK_MAX
+#define PILE_MAX_CAP STOCK_CAP
+
+// The stock and the waste, whose cards go round between the two. No pile is
+// at LOC_DECK.
+#define _PILE_IS_TALON(pile) ((pile)->location <= LOC_WASTE)
 
 #define _PILE_IS_TABLEAU(pile) (\
     ((pile)->location >= LOC_TAB0) && ((pile)->location <= LOC_TAB6))
@@ -46,6 +62,24 @@ enum card_color {
     COLOR_MAX,
 };
 
+// Reasons a move is rejected, see move_status_str for the messages
+enum move_status {
+    MOVE_OK,
+    MOVE_ERR_NO_CARD,
+    MOVE_ERR_NOT_FACE_UP,
+    MOVE_ERR_DST_NOT_FACE_UP,
+    MOVE_ERR_SRC_PILE,
+    MOVE_ERR_DST_PILE,
+    MOVE_ERR_SAME_CARD,
+    MOVE_ERR_NOT_TOP,
+    MOVE_ERR_NOT_KING,
+    MOVE_ERR_NOT_ACE,
+    MOVE_ERR_COLOR,
+    MOVE_ERR_SUIT,
+    MOVE_ERR_RANK,
+    MOVE_STATUS_MAX,
+};
+
 enum card_location {
     LOC_DECK,
     LOC_STOCK,
@@ -64,13 +98,28 @@ enum card_location {
 };
 
 
+struct card;
+struct field;
+
+/*
+ * A pile is a fixed capacity array of indices into the deck's card array. The
+ * bottom card is at index 0 and the top card is at index len - 1. field points
+ * at the field that owns the pile, whose Zobrist key the pile keeps up to date.
+ */
 struct pile {
-    struct list_head list;
+    uint8_t cards[PILE_MAX_CAP];
+    struct card *base;
+    struct field *field;
     int len;
     int cap;
     enum card_location location;
 };
 
+/*
+ * pile, pos, location and face_up of a stock or waste card are not updated
+ * when the waste is recycled, only when the card is next reached through its
+ * pile. Stock cards are always face down and waste cards always face up.
+ */
 struct card {
     enum card_suit suit;
     enum card_rank rank;
@@ -78,9 +127,49 @@ struct card {
     bool face_up;
     enum card_location location;
     struct pile *pile;
-    struct list_head list;
+    int pos;
 };
 
+// Points a card at slot i of pile. A stock or waste card also takes the face
+// of its pile, which is how cards catch up after a recycle.
+static inline void
+_pile_stamp(struct pile *pile, struct card *card, int i)
+{
+    card->pos = i;
+    card->pile = pile;
+    card->location = pile->location;
+    if (_PILE_IS_TALON(pile))
+        card->face_up = pile->location == LOC_WASTE;
+}
+
+// Returns the i-th card counting up from the bottom of the pile.
+static inline struct card *
+_pile_card(struct pile *pile, int i)
+{
+    struct card *card = pile->base + pile->cards[i];
+    if (_PILE_IS_TALON(pile))
+        _pile_stamp(pile, card, i);
+    return card;
+}
+
+/**
+ * pile_for_each_card - Iterate over a pile from the top card to the bottom.
+ * @card: struct card * used as the loop cursor
+ * @i: int used as the loop index
+ * @pile: struct pile * to iterate over
+ */
+#define pile_for_each_card(card, i, pile) \
+    for ((i) = (pile)->len - 1; \
+        (i) >= 0 && ((card) = _pile_card((pile), (i)), true); \
+        --(i))
+
+// Deck independent identifier of a card in the range [0, SOLITAIRE_DECK_SIZE)
+static inline int
+card_id(struct card *card)
+{
+    return card->suit * RANK_MAX + card->rank;
+}
+
 static inline enum card_rank
 card_rank(struct card *card)
 {
@@ -105,26 +194,86 @@ card_pile(struct card *card)
     return card->pile;
 }
 
+struct arena;
+
 struct deck {
     struct card *cards;
-    struct list_head list;
+    struct arena *arena;    // Owns cards, or NULL for the heap
+    uint64_t seed;
+    uint8_t index[SUIT_MAX][RANK_MAX];
     int len;
     bool initialized;
 };
 
 
+/*
+ * A move of the top cnt cards of pile src onto pile dst, both given as their
+ * enum card_location. Dealing is LOC_STOCK to LOC_WASTE with a cnt of 1 and
+ * recycling the waste is LOC_WASTE to LOC_STOCK with a cnt of the waste size.
+ */
+struct card_move {
+    uint8_t src;
+    uint8_t dst;
+    uint8_t cnt;
+};
+
+// No position can have more legal moves than this
+#define FIELD_MAX_MOVES 256
+
+/*
+ * One move of the history. Piles are kept as their location - LOC_STOCK, not
+ * as pointers, so a history means the same thing in any field it is copied to.
+ * A deal is recorded as stock to waste and a recycle as waste to stock, as in
+ * struct card_move.
+ */
 struct card_action {
-    struct card *card;
-    struct pile *src;
-    struct pile *dst;
+    uint16_t src : 4;
+    uint16_t dst : 4;
+    uint16_t cnt : 5;       // Cards moved, up to a whole waste
+    uint16_t flipped : 1;   // The move turned the card under it face up
+    uint16_t recycle : 1;   // The waste went back into the stock
 };
 
+_Static_assert(sizeof(struct card_action) == 2,
+    "struct card_action must pack into 16 bits");
+_Static_assert(WASTE_CAP < 32, "struct card_action cnt is 5 bits");
+
 struct history {
     struct card_action *actions;
+    struct arena *arena;    // Owns actions, or NULL for the heap
     int cnt;
     int cap;
 };
 
+#define FIELD_PACK_FACE_UP 0x40
+#define FIELD_PACK_ID_MASK 0x3f
+
+/*
+ * Packed position. Every card is one byte holding its card_id and face up bit,
+ * listed pile by pile from the stock to the last foundation and from bottom to
+ * top within a pile. The lengths of all but the last pile follow, the last one
+ * being whatever is left of the deck. Unused bits are always zero so two packs
+ * of the same position compare equal with memcmp.
+ */
+struct field_pack {
+    uint8_t cards[SOLITAIRE_DECK_SIZE];
+    uint8_t lens[NUM_PILES - 1];
+};
+
+_Static_assert(sizeof(struct field_pack) == 64, "field_pack must be 64 bytes");
+
+/*
+ * A game put away in little memory: its deal number, its position and the
+ * history that led there. The deck and the field can be dropped while it is
+ * kept, which saves their card array, pile bookkeeping and spare history.
+ */
+struct field_frozen {
+    uint64_t seed;
+    struct card_action *actions;    // Exactly cnt long, or NULL
+    int cnt;
+    struct field_pack pack;
+};
+
 struct field {
     struct deck *deck;
     struct pile stock;
@@ -132,6 +281,15 @@ struct field {
     struct pile tableaus[NUM_TABLEAU];
     struct pile foundations[NUM_FOUNDATION];
     struct history history;
+    uint64_t hash;
+    uint64_t talon;     // Change to hash when the waste is recycled
+    // Kept by dead_end_check, by location - LOC_STOCK. The bits are card ids
+    // and the stock stands for all stock and waste cards.
+    uint16_t dirty;                 // Piles changed since the last check
+    uint64_t offers[NUM_PILES];     // Cards a pile can usefully move
+    uint64_t wants[NUM_PILES];      // Cards a pile can take
+    uint64_t tops[NUM_PILES];       // Tableau top cards, for the foundations
+    bool dead_end;                  // Result of the last check
     int moves;
 };
 
@@ -0,0 +1,145 @@
+#include "counters.h"
+#include <linux/perf_event.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+struct counter_event {
+    uint32_t type;
+    uint64_t config;
+    char const *name;
+};
+
+// What perf_event_read gives for a group leader with PERF_FORMAT_GROUP,
+// PERF_FORMAT_TOTAL_TIME_ENABLED and PERF_FORMAT_TOTAL_TIME_RUNNING. The
+// values are in the order the events joined the group, leader first.
+struct counter_read {
+    uint64_t nr;
+    uint64_t enabled;
+    uint64_t running;
+    uint64_t values[COUNTER_MAX];
+};
+
+#define _HW_CACHE_MISS(cache) \
+    ((cache) \
+     | (PERF_COUNT_HW_CACHE_OP_READ << 8) \
+     | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static struct counter_event const _events[COUNTER_MAX] = {
+    [COUNTER_CYCLES] = {
+        PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles"
+    },
+    [COUNTER_INSTRUCTIONS] = {
+        PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions"
+    },
+    [COUNTER_L1D_MISSES] = {
+        PERF_TYPE_HW_CACHE, _HW_CACHE_MISS(PERF_COUNT_HW_CACHE_L1D),
+        "l1d-misses"
+    },
+    [COUNTER_LLC_MISSES] = {
+        PERF_TYPE_HW_CACHE, _HW_CACHE_MISS(PERF_COUNT_HW_CACHE_LL),
+        "llc-misses"
+    },
+    [COUNTER_BRANCH_MISSES] = {
+        PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, "branch-misses"
+    },
+};
+
+static inline int
+_event_open(struct counter_event const *event, int group);
+
+// INTERNAL IMPLEMENTATION
+
+static inline int
+_event_open(struct counter_event const *event, int group)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(struct perf_event_attr));
+    attr.size = sizeof(struct perf_event_attr);
+    attr.type = event->type;
+    attr.config = event->config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED
+        | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    // This thread, on any CPU. glibc has no wrapper for the call.
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+// EXTERNAL / PUBLIC FUNCTIONS
+
+int
+counters_open(struct counters *counters)
+{
+    int cnt = 0;
+    int i;
+
+    // The first event that opens leads the group the others join, so the
+    // kernel only ever runs them all at once
+    counters->group = -1;
+    for (i = 0; i < COUNTER_MAX; ++i) {
+        counters->fds[i] = _event_open(&_events[i], counters->group);
+        if (counters->fds[i] < 0)
+            continue;
+        if (counters->group < 0)
+            counters->group = counters->fds[i];
+        cnt++;
+    }
+    return cnt;
+}
+
+void
+counters_close(struct counters *counters)
+{
+    int i;
+    for (i = 0; i < COUNTER_MAX; ++i) {
+        if (counters->fds[i] >= 0)
+            close(counters->fds[i]);
+        counters->fds[i] = -1;
+    }
+    counters->group = -1;
+}
+
+bool
+counters_available(struct counters *counters, enum counter counter)
+{
+    return counters->fds[counter] >= 0;
+}
+
+void
+counters_read(struct counters *counters, struct counters_sample *sample)
+{
+    struct counter_read buf;
+    ssize_t len = -1;
+    int n = 0;
+    int i;
+
+    memset(sample, 0, sizeof(struct counters_sample));
+    if (counters->group >= 0)
+        len = read(counters->group, &buf, sizeof(buf));
+    if (len < (ssize_t)offsetof(struct counter_read, values)
+        || buf.running == 0)
+        return;
+
+    // One time for the whole group, so every count is scaled alike
+    double scale = 1;
+    if (buf.running < buf.enabled)
+        scale = (double)buf.enabled / (double)buf.running;
+    for (i = 0; i < COUNTER_MAX; ++i) {
+        if (counters->fds[i] < 0)
+            continue;
+        if (n >= (int)buf.nr)
+            break;
+        sample->values[i] = (uint64_t)((double)buf.values[n++] * scale);
+    }
+}
+
+char const *
+counter_str(enum counter counter)
+{
+    if (counter < 0 || counter >= COUNTER_MAX)
+        return "unknown";
+    return _events[counter].name;
+}
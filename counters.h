@@ -0,0 +1,65 @@
+#ifndef SOLITAIRE_COUNTERS_H_
+#define SOLITAIRE_COUNTERS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+enum counter {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_L1D_MISSES,
+    COUNTER_LLC_MISSES,
+    COUNTER_BRANCH_MISSES,
+    COUNTER_MAX,
+};
+
+/*
+ * Hardware performance counters of the calling thread, read through
+ * perf_event_open. Only user space is counted, so this works with the default
+ * perf_event_paranoid setting. Counters the CPU or kernel does not offer, as
+ * is common in virtual machines, are left out rather than failing the rest.
+ * The others are opened as one group, so they all count over the same time.
+ */
+struct counters {
+    int fds[COUNTER_MAX];
+    int group;                  // Leader of the group, or -1
+};
+
+struct counters_sample {
+    uint64_t values[COUNTER_MAX];
+};
+
+/**
+ * counters_open - Start counting.
+ * @counters: struct counters * to set up
+ *
+ * Returns the number of counters that could be opened, leaving errno set by
+ * the last that could not. counters_close must be called either way.
+ */
+int
+counters_open(struct counters *counters);
+
+void
+counters_close(struct counters *counters);
+
+bool
+counters_available(struct counters *counters, enum counter counter);
+
+/**
+ * counters_read - Read every open counter.
+ * @counters: struct counters * set up by counters_open
+ * @sample: struct counters_sample * to store the counts in
+ *
+ * The group is read at once, so the cost of some code is the difference of
+ * two samples. When the kernel has to share the hardware with other users,
+ * the counts are scaled up from the time the group ran. The scale changes
+ * from one sample to the next, so a later count can come out a little lower.
+ * Counters that are not open read as 0.
+ */
+void
+counters_read(struct counters *counters, struct counters_sample *sample);
+
+char const *
+counter_str(enum counter counter);
+
+#endif // SOLITAIRE_COUNTERS_H_
@@ -0,0 +1,48 @@
+#include "deal.h"
+#include "rng.h"
+#include <string.h>
+
+static uint8_t const _standard[SOLITAIRE_DECK_SIZE] = {
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12,
+    13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25,
+    26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38,
+    39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51,
+};
+
+static inline void
+_deal_permute(uint64_t seed, uint8_t *perm);
+
+// INTERNAL IMPLEMENTATION
+
+// Fisher-Yates shuffle of the card ids
+static inline void
+_deal_permute(uint64_t seed, uint8_t *perm)
+{
+    struct rng rng;
+    int i;
+
+    rng_seed(&rng, seed);
+    memcpy(perm, _standard, SOLITAIRE_DECK_SIZE);
+    for (i = SOLITAIRE_DECK_SIZE - 1; i > 0; --i) {
+        int j = (int)rng_bounded(&rng, (uint32_t)i + 1);
+        uint8_t t = perm[i];
+        perm[i] = perm[j];
+        perm[j] = t;
+    }
+}
+
+// EXTERNAL / PUBLIC FUNCTIONS
+
+void
+deal_permute(uint64_t seed, uint8_t *perm)
+{
+    _deal_permute(seed, perm);
+}
+
+void
+deal_gen_bulk(uint8_t *out, uint64_t first, size_t cnt)
+{
+    size_t i;
+    for (i = 0; i < cnt; ++i)
+        _deal_permute(first + i, out + i * SOLITAIRE_DECK_SIZE);
+}
@@ -0,0 +1,32 @@
+#ifndef SOLITAIRE_DEAL_H_
+#define SOLITAIRE_DEAL_H_
+
+#include "card_type.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * deal_permute - Write the deck order of a numbered deal.
+ * @seed: uint64_t deal number
+ * @perm: uint8_t[SOLITAIRE_DECK_SIZE] to fill in
+ *
+ * perm[i] is the card_id of the i-th card of the deck deck_init_seeded deals
+ * for the same number.
+ */
+void
+deal_permute(uint64_t seed, uint8_t *perm);
+
+/**
+ * deal_gen_bulk - Write the deck orders of a range of deals.
+ * @out: uint8_t * with room for cnt * SOLITAIRE_DECK_SIZE bytes
+ * @first: uint64_t deal number of the first deal
+ * @cnt: number of deals to write
+ *
+ * Deal first + i goes to out + i * SOLITAIRE_DECK_SIZE, laid out as by
+ * deal_permute. Only card ids are shuffled, never struct cards, and nothing
+ * is allocated, so the whole range can go to a buffer reused between calls.
+ */
+void
+deal_gen_bulk(uint8_t *out, uint64_t first, size_t cnt);
+
+#endif // SOLITAIRE_DEAL_H_
@@ -1,10 +1,12 @@
 #include "debug.h"
 #include "game.h"
+#include "render.h"
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <unistd.h>
 
 #define u32_to_u8(u) \
     (((u) >> 16) & 0xff), \
@@ -42,16 +44,21 @@ _pile_count(struct pile *pile)
 {
     struct card *card;
     int cnt = 0;
-    list_for_each_entry(card, &pile->list, list)
+    int i;
+    pile_for_each_card(card, i, pile) {
+        if (card->pile != pile || card->pos != i)
+            break;
         cnt++;
+    }
     return cnt;
 }
 
+// Checks that every card in the pile points back at the pile and its slot
 bool
 _pile_len_matches_count(struct pile *pile)
 {
     int cnt = _pile_count(pile);
-    return pile->len == cnt;
+    return pile->len == cnt && pile->len <= pile->cap;
 }
 
 
@@ -199,20 +206,6 @@ card_print(struct card *card)
 }
 
 
-void
-card_list_print(struct list_head *head)
-{
-    if (list_empty(head)) {
-        printf("List empty!\n");
-        return;
-    }
-
-    struct card *card;
-
-    list_for_each_entry(card, head, list)
-        _card_print(card, false);
-}
-
 void
 deck_print(struct deck *deck)
 {
@@ -224,13 +217,14 @@ deck_print(struct deck *deck)
 void
 pile_print(struct pile *pile)
 {
-    if (list_empty(&pile->list)) {
+    if (pile_empty(pile)) {
         printf("List empty!\n");
         return;
     }
 
     struct card *card;
-    list_for_each_entry(card, &pile->list, list)
+    int i;
+    pile_for_each_card(card, i, pile)
         _card_sym_puts(card);
 }
 
@@ -254,64 +248,12 @@ field_print_top_cards(struct field *field)
 void
 field_sym_print(struct field *field)
 {
-    struct card *card;
-    printf("stock/waste: ");
-    card = pile_top_card(&field->stock);
-    if (card == NULL)
-        printf("EE");
-    else
-        printf("XX");
-    // _card_sym_print(card);
-
-    printf("    ");
-    card = pile_top_card(&field->waste);
-    if (card != NULL)
-        _card_sym_print(card);
-    else
-        printf("  ");
-    printf("    foundations: ");
-
-    int i;
-    for (i = 0; i < NUM_FOUNDATION; ++i) {
-        card = pile_top_card(&field->foundations[i]);
-        if (card == NULL)
-            printf("XX");
-        else
-            _card_sym_print(card);
-        printf("  ");
-    }
-
-    printf("\n");
-
-    int height = 0;
-    int counts[NUM_TABLEAU];
-    for (i = 0; i < NUM_TABLEAU; ++i) {
-        counts[i] = _pile_count(&field->tableaus[i]);
-        if (counts[i] > height)
-            height = counts[i];
-    }
-
-    printf("tableaus:\n");
-    int row;
-    int col;
-    for (row = height - 1; row >= 0; --row) {
-        for (col = 0; col < NUM_TABLEAU; ++col) {
-            if (row <= counts[col]) {
-                card = pile_get_nth_card(&field->tableaus[col], row);
-                if (card == NULL)
-                    printf("  ");
-                else if (card->face_up)
-                    _card_sym_print(card);
-                else
-                    printf("XX");
-                printf("  ");
-            } else {
-                printf("    ");
-            }
-        }
-        printf("\n");
-    }
-    printf("\n");
+    struct render render;
+    render_frame(&render, field);
+    // Anything printf still holds goes out first
+    fflush(stdout);
+    if (render_flush(&render, STDOUT_FILENO) < 0)
+        perror("write");
 }
 
 void
@@ -320,10 +262,11 @@ field_print(struct field *field)
     struct card *card;
     int num = 0;
     int cnt = 0;
+    int j;
     printf("Stock:\n");
     cnt += field->stock.len;
     cnt += field->waste.len;
-    list_for_each_entry(card, &field->stock.list, list) {
+    pile_for_each_card(card, j, &field->stock) {
         // _card_print(card, false);
         _card_sym_puts(card);
         num++;
@@ -331,7 +274,7 @@ field_print(struct field *field)
     assert(_pile_len_matches_count(&field->stock));
     printf("\n");
     printf("Waste:\n");
-    list_for_each_entry(card, &field->waste.list, list) {
+    pile_for_each_card(card, j, &field->waste) {
         // _card_print(card, false);
         _card_sym_puts(card);
         num++;
@@ -341,8 +284,8 @@ field_print(struct field *field)
     int i;
     for (i = 0; i < NUM_TABLEAU; ++i) {
         printf("Tableau %i\n", i + 1);
-        if (!list_empty(&field->tableaus[i].list))
-            list_for_each_entry(card, &field->tableaus[i].list, list) {
+        if (!pile_empty(&field->tableaus[i]))
+            pile_for_each_card(card, j, &field->tableaus[i]) {
                 // _card_print(card, false);
                 _card_sym_puts(card);
                 num++;
@@ -354,8 +297,8 @@ field_print(struct field *field)
 
     for (i = 0; i < NUM_FOUNDATION; ++i) {
         printf("Foundation %i\n", i + 1);
-        if (!list_empty(&field->foundations[i].list))
-            list_for_each_entry(card, &field->foundations[i].list, list) {
+        if (!pile_empty(&field->foundations[i]))
+            pile_for_each_card(card, j, &field->foundations[i]) {
                 // _card_print(card, false);
                 _card_sym_puts(card);
                 num++;
@@ -5,9 +5,6 @@
 void
 card_print(struct card *card);
 
-void
-card_list_print(struct list_head *head);
-
 void
 deck_print(struct deck *deck);
 
@@ -2,6 +2,9 @@
 #include "game.h"
 // #include "test.h"
 #include "debug.h"
+#include "arena.h"
+#include "deal.h"
+#include "rng.h"
 #include <assert.h>
 #include <ctype.h>
 #include <errno.h>
@@ -13,20 +16,8 @@
 #include <time.h>
 #include <unistd.h>
 #include <termios.h>
-
-#define SOLITAIRE_DECK_SIZE (RANK_MAX * SUIT_MAX)
-
-#define list_last_entry_or_null(ptr, type, member) ({ \
-    struct list_head *head__ = (ptr); \
-    struct list_head *pos__ = head__->prev; \
-    pos__ != head__ ? list_entry(pos__, type, member) : NULL; \
-    })
-
-#define ERR_MSG(msg) assert(msg)
-#if !defined ERR_MSG
-#define ERR_MSG(msg) \
-    fprintf(stderr, "In func %s: ", __func__), \
-    fprintf(stderr, msg)
+#ifdef __SSE2__
+#include <emmintrin.h>
 #endif
 
 /**
@@ -48,28 +39,44 @@ _str_last_char(char *str);
 static inline int
 _str_get_digit(char *str);
 
+// HASH
+static inline uint64_t
+_zobrist_key(struct card *card, struct pile *pile);
+
+static inline uint64_t
+_talon_key(struct card *card);
+
 // PILE
 static inline void
-_pile_set_card_locations(struct pile *pile);
+_pile_init(
+    struct pile *pile,
+    struct card *base,
+    struct field *field,
+    int cap,
+    enum card_location location
+    );
 
 static inline void
-_pile_set_card_piles(struct pile *pile);
+_pile_push(struct pile *pile, struct card *card);
 
-// DECK
-static inline void
-_deck_enqueue(struct deck *deck);
+static inline struct card *
+_pile_pop(struct pile *pile);
 
 static inline void
-_deck_shuffle(struct deck *deck);
+_pile_move_top(struct pile *src_pile, struct pile *dst_pile, int n);
 
-static inline int
-_deck_generate_standard(struct deck *deck);
+static inline bool
+_pile_flip_top(struct pile *pile);
+
+// DECK
+static inline void
+_deck_alloc(struct deck *deck, struct arena *arena);
 
 static inline void
-_pile_top_set_location(struct pile *pile);
+_deck_generate(struct deck *deck, uint8_t const *ids);
 
 static inline void
-_pile_top_set_pile(struct pile *pile);
+_deck_index(struct deck *deck);
 
 static inline bool
 _pile_is_waste(struct pile *pile);
@@ -86,6 +93,15 @@ _pile_is_stock(struct pile *pile);
 static inline bool
 _card_color_valid(struct card *card);
 
+static inline enum move_status
+_tableau_move_check(struct card *src, struct card *dst);
+
+static inline enum move_status
+_foundation_move_check(struct card *src, struct card *dst);
+
+static inline enum move_status
+_move_check(struct card *src_card, struct pile *dst_pile);
+
 static inline bool
 _tableau_move_valid(struct card *src, struct card *dst);
 
@@ -98,40 +114,156 @@ _move_valid(struct card *src_card, struct pile *dst_pile);
 static inline bool
 _move_stock_to_waste(struct pile *stock, struct pile *waste);
 
-static inline bool
+static inline enum move_status
 _move_pile_to_pile_single(struct pile *src_pile, struct pile *dst_pile);
 
 static inline void
 _move_stack(struct card *src_card, struct pile *dst_pile);
 
 static inline void
-_move_card_to_pile(struct card *src_card, struct pile *dst_pile);
+_talon_recycle(struct pile *src_pile, struct pile *dst_pile);
 
 static inline void
 _move_card(struct card *src, struct card *dst);
 
 static inline void
-_field_history_init(struct field *field);
+_gen_tops(struct field *field, uint8_t *tops);
+
+static inline unsigned
+_gen_dsts(uint8_t const *tops, struct card *src_card);
+
+static inline int
+_gen_moves_to(
+    struct card *src_card,
+    unsigned dsts,
+    struct card_move *moves,
+    int cnt,
+    int max
+    );
+
+static inline void
+_field_history_init(struct field *field, struct arena *arena);
+
+static inline void
+_field_history_grow(struct field *field);
+
+static inline void
+_field_deal(struct field *field, struct deck *deck);
+
+static inline void
+_field_piles_init(struct field *field, struct deck *deck);
 
 static inline void
 _field_snapshot(struct field *field, struct card_action *act);
 
-static inline struct card_action
-_action_store(struct card *card, struct pile *src, struct pile *dst);
+static inline uint64_t
+_pile_offers(struct field *field, struct pile *pile);
 
-static inline struct card_action
-_history_pop(struct field *field);
+static inline uint64_t
+_pile_wants(struct pile *pile);
+
+static inline void
+_field_history_reserve(struct field *field, int cnt);
 
 static inline void
 _history_push(
     struct field *field,
-    struct card *card,
     struct pile *src,
-    struct pile *dst
+    struct pile *dst,
+    int cnt,
+    bool flipped,
+    bool recycle
     );
 
 // INTERNAL IMPLEMENTATION
 
+// Zobrist keys indexed by card id, pile and whether the card is face up
+static uint64_t _zobrist[SOLITAIRE_DECK_SIZE][NUM_PILES][2];
+
+__attribute__((constructor)) static void
+_zobrist_init(void)
+{
+    uint64_t state = 0x6b6c6f6e64696b65ULL;
+    int i;
+    int j;
+    for (i = 0; i < SOLITAIRE_DECK_SIZE; ++i) {
+        for (j = 0; j < NUM_PILES; ++j) {
+            _zobrist[i][j][0] = rng_splitmix64(&state);
+            _zobrist[i][j][1] = rng_splitmix64(&state);
+        }
+    }
+}
+
+static inline uint64_t
+_zobrist_key(struct card *card, struct pile *pile)
+{
+    return _zobrist[card_id(card)][pile->location - LOC_STOCK][card->face_up];
+}
+
+/*
+ * Move legality by card id, worked out by the compiler. Bit d of
+ * _tableau_parents[s] is set when card s can go onto card d on a tableau and
+ * _tableau_children is the same table turned around. _foundation_parents
+ * holds the card below each card in its suit. _tableau_parent_ids lists the
+ * at most two set bits of _tableau_parents, CARD_ID_NONE filling the rest.
+ * Cards of the other color are in the suits of the other parity.
+ */
+#define CARD_ID_NONE 0xff
+#define _ID_SUIT(id) ((id) / RANK_MAX)
+#define _ID_RANK(id) ((id) % RANK_MAX)
+#define _ID_OF(suit, rank) ((suit) * RANK_MAX + (rank))
+#define _TAB_PARENT_ID(id, k) (_ID_RANK(id) == RANK_K ? CARD_ID_NONE \
+    : _ID_OF(_ID_SUIT(id) ^ (k), _ID_RANK(id) + 1))
+#define _TAB_CHILD_ID(id, k) (_ID_RANK(id) == RANK_A ? CARD_ID_NONE \
+    : _ID_OF(_ID_SUIT(id) ^ (k), _ID_RANK(id) - 1))
+#define _ID_BIT(id) ((id) == CARD_ID_NONE ? 0 : 1ULL << (id))
+#define _TAB_PARENTS(id) \
+    (_ID_BIT(_TAB_PARENT_ID(id, 1)) | _ID_BIT(_TAB_PARENT_ID(id, 3)))
+#define _TAB_CHILDREN(id) \
+    (_ID_BIT(_TAB_CHILD_ID(id, 1)) | _ID_BIT(_TAB_CHILD_ID(id, 3)))
+#define _FOUND_PARENT(id) (_ID_RANK(id) == RANK_A ? 0 : 1ULL << ((id) - 1))
+#define _TAB_PARENT_IDS(id) { _TAB_PARENT_ID(id, 1), _TAB_PARENT_ID(id, 3) }
+
+#define _SUIT_TABLE(f, s) \
+    f((s) + 0), f((s) + 1), f((s) + 2), f((s) + 3), f((s) + 4), \
+    f((s) + 5), f((s) + 6), f((s) + 7), f((s) + 8), f((s) + 9), \
+    f((s) + 10), f((s) + 11), f((s) + 12)
+#define _DECK_TABLE(f) { \
+    _SUIT_TABLE(f, 0 * RANK_MAX), _SUIT_TABLE(f, 1 * RANK_MAX), \
+    _SUIT_TABLE(f, 2 * RANK_MAX), _SUIT_TABLE(f, 3 * RANK_MAX) }
+
+_Static_assert(RANK_MAX == 13 && SUIT_MAX == 4,
+    "_SUIT_TABLE and _DECK_TABLE list every card");
+_Static_assert(SUIT_SPADE % 2 == SUIT_CLUB % 2
+    && SUIT_DIAMOND % 2 == SUIT_HEART % 2
+    && SUIT_SPADE % 2 != SUIT_HEART % 2,
+    "the suits of a color must share a parity");
+
+static uint64_t const _tableau_parents[] = _DECK_TABLE(_TAB_PARENTS);
+static uint64_t const _tableau_children[] = _DECK_TABLE(_TAB_CHILDREN);
+static uint64_t const _foundation_parents[] = _DECK_TABLE(_FOUND_PARENT);
+static uint8_t const _tableau_parent_ids[][2] = _DECK_TABLE(_TAB_PARENT_IDS);
+
+// Letters of the ranks and suits in move notation, in enum order
+static char const _rank_chars[] = "a23456789xjqk";
+static char const _suit_chars[] = "sdch";
+
+// Kings go to empty tableaus and aces to empty foundations
+#define _KINGS (_ID_BIT(_ID_OF(0, RANK_K)) | _ID_BIT(_ID_OF(1, RANK_K)) \
+    | _ID_BIT(_ID_OF(2, RANK_K)) | _ID_BIT(_ID_OF(3, RANK_K)))
+#define _ACES (_ID_BIT(_ID_OF(0, RANK_A)) | _ID_BIT(_ID_OF(1, RANK_A)) \
+    | _ID_BIT(_ID_OF(2, RANK_A)) | _ID_BIT(_ID_OF(3, RANK_A)))
+
+// What a card adds to the hash going from face up in the waste to face down in
+// the stock
+static inline uint64_t
+_talon_key(struct card *card)
+{
+    int id = card_id(card);
+    return _zobrist[id][LOC_WASTE - LOC_STOCK][1]
+        ^ _zobrist[id][LOC_STOCK - LOC_STOCK][0];
+}
+
 
 static inline void
 _str_to_lower(char *str)
@@ -171,39 +303,72 @@ _str_get_digit(char *str)
 
 
 static inline void
-_pile_set_card_locations(struct pile *pile)
+_pile_init(
+    struct pile *pile,
+    struct card *base,
+    struct field *field,
+    int cap,
+    enum card_location location
+    )
 {
-    struct card *card;
-    list_for_each_entry(card, &pile->list, list)
-        card->location = pile->location;
+    assert(cap <= PILE_MAX_CAP);
+    pile->base = base;
+    pile->field = field;
+    pile->len = 0;
+    pile->cap = cap;
+    pile->location = location;
 }
 
+// Marks the pile for dead_end_check to look at again
 static inline void
-_pile_set_card_piles(struct pile *pile)
+_pile_dirty(struct pile *pile)
 {
-    struct card *card;
-    list_for_each_entry(card, &pile->list, list)
-        card->pile = pile;
+    pile->field->dirty |= (uint16_t)(1 << (pile->location - LOC_STOCK));
 }
 
 static inline void
-_pile_top_set_location(struct pile *pile)
+_pile_push(struct pile *pile, struct card *card)
 {
-    struct card *card = pile_top_card(pile);
-    if (card == NULL) {
-        fprintf(stderr, "CARD WAS NULL UNABLE TO SET LOCATION %s\n", __func__);
-        return;
-    }
-    card->location = pile->location;
+    assert(pile->len < pile->cap);
+    _pile_stamp(pile, card, pile->len);
+    pile->cards[pile->len++] = (uint8_t)(card - pile->base);
+    pile->field->hash ^= _zobrist_key(card, pile);
+    if (_PILE_IS_TALON(pile))
+        pile->field->talon ^= _talon_key(card);
+    _pile_dirty(pile);
 }
 
+// Takes the card out of the hash of pile, as the top card popped off it
 static inline void
-_pile_top_set_pile(struct pile *pile)
+_pile_unhash(struct pile *pile, struct card *card)
 {
-    struct card *card = pile_top_card(pile);
-    if (card == NULL)
-        return;
-    card->pile = pile;
+    pile->field->hash ^= _zobrist_key(card, pile);
+    if (_PILE_IS_TALON(pile))
+        pile->field->talon ^= _talon_key(card);
+    _pile_dirty(pile);
+}
+
+static inline struct card *
+_pile_pop(struct pile *pile)
+{
+    assert(pile->len > 0);
+    struct card *card = _pile_card(pile, --pile->len);
+    _pile_unhash(pile, card);
+    return card;
+}
+
+// Moves the top n cards of src_pile onto dst_pile, keeping their order.
+static inline void
+_pile_move_top(struct pile *src_pile, struct pile *dst_pile, int n)
+{
+    assert(n <= src_pile->len);
+    int i;
+    for (i = src_pile->len - n; i < src_pile->len; ++i) {
+        struct card *card = _pile_card(src_pile, i);
+        _pile_unhash(src_pile, card);
+        _pile_push(dst_pile, card);
+    }
+    src_pile->len -= n;
 }
 
 static inline bool
@@ -238,45 +403,37 @@ _card_color_valid(struct card *card)
     return card->color == COLOR_RED || card->color == COLOR_BLACK;
 }
 
-static inline bool
-_tableau_move_valid(struct card *src_card, struct card *dst_card)
+static inline enum move_status
+_tableau_move_check(struct card *src_card, struct card *dst_card)
 {
     // Assert colors are not out of range
     if (dst_card != NULL)
         assert(_card_color_valid(dst_card));
 
     // Ensure from card exists
-    if (src_card == NULL) {
-        ERR_MSG("Source card does not exist\n");
-        return false;
-    }
+    if (src_card == NULL)
+        return MOVE_ERR_NO_CARD;
     assert(_card_color_valid(src_card));
 
     // CASE: Tableau is empty so selected card must be king
-    if (dst_card == NULL && src_card->rank == RANK_K) {
-        return true;
-    } else if (dst_card == NULL && src_card->rank != RANK_K) {
-        ERR_MSG("No card in dest tableau, but source card is not King!\n");
-        return false;
-    }
+    if (dst_card == NULL && src_card->rank == RANK_K)
+        return MOVE_OK;
+    else if (dst_card == NULL && src_card->rank != RANK_K)
+        return MOVE_ERR_NOT_KING;
 
     // CASE: Colors must be opposite
-    if (dst_card->color == src_card->color) {
-        ERR_MSG("Colors are not opposite!\n");
-        return false;
-    }
+    if (dst_card->color == src_card->color)
+        return MOVE_ERR_COLOR;
 
     // CASE: Number must be 1 less to move
-    if (src_card->rank != dst_card->rank - 1) {
-        ERR_MSG("Dest must be one less than source card\n");
-        return false;
-    }
+    if (src_card->rank != dst_card->rank - 1)
+        return MOVE_ERR_RANK;
 
-    return true;
+    return MOVE_OK;
 }
 
-static inline bool
-_foundation_move_valid(struct card *src_card, struct card *dst_card)
+static inline enum move_status
+_foundation_move_check(struct card *src_card, struct card *dst_card)
 {
     if (dst_card != NULL) {
         assert(_card_color_valid(dst_card));
@@ -293,23 +450,51 @@ _foundation_move_valid(struct card *src_card, struct card *dst_card)
     // CASE: Foundation is empty
     if (dst_card == NULL) {
         if (src_card->rank == RANK_A)
-            return true;
-        return false;
+            return MOVE_OK;
+        return MOVE_ERR_NOT_ACE;
     }
 
     if (dst_card->suit != src_card->suit)
-        return false;
+        return MOVE_ERR_SUIT;
 
     if (dst_card->rank != src_card->rank - 1)
-        return false;
+        return MOVE_ERR_RANK;
 
-    return true;
+    return MOVE_OK;
+}
+
+static inline enum move_status
+_move_check(struct card *src_card, struct pile *dst_pile)
+{
+    assert(src_card != NULL);
+    if (_pile_is_foundation(dst_pile))
+        return _foundation_move_check(src_card, pile_top_card(dst_pile));
+    if (_pile_is_tableau(dst_pile))
+        return _tableau_move_check(src_card, pile_top_card(dst_pile));
+    return MOVE_ERR_DST_PILE;
+}
+
+// The same answer as _tableau_move_check, as one table lookup
+static inline bool
+_tableau_move_valid(struct card *src_card, struct card *dst_card)
+{
+    if (dst_card == NULL)
+        return (_KINGS >> card_id(src_card)) & 1;
+    return (_tableau_parents[card_id(src_card)] >> card_id(dst_card)) & 1;
+}
+
+// The same answer as _foundation_move_check, as one table lookup
+static inline bool
+_foundation_move_valid(struct card *src_card, struct card *dst_card)
+{
+    if (dst_card == NULL)
+        return (_ACES >> card_id(src_card)) & 1;
+    return (_foundation_parents[card_id(src_card)] >> card_id(dst_card)) & 1;
 }
 
 static inline bool
 _move_valid(struct card *src_card, struct pile *dst_pile)
 {
-    assert(src_card != NULL);
     if (_pile_is_foundation(dst_pile))
         return _foundation_move_valid(src_card, pile_top_card(dst_pile));
     if (_pile_is_tableau(dst_pile))
@@ -317,74 +502,79 @@ _move_valid(struct card *src_card, struct pile *dst_pile)
     return false;
 }
 
+// Flips the top card face up, returning whether it was face down
+static inline bool
+_pile_flip_top(struct pile *pile)
+{
+    struct card *card = pile_top_card(pile);
+    if (card == NULL || card->face_up)
+        return false;
+    card_flip(card);
+    return true;
+}
+
 // DECK
+
 static inline void
-_deck_enqueue(struct deck *deck)
+_deck_alloc(struct deck *deck, struct arena *arena)
 {
-    struct list_head *head = &deck->list;
-    INIT_LIST_HEAD(head);
-    int i;
-    for (i = 0; i < deck->len; ++i) {
-        list_add_tail(&deck->cards[i].list, head);
-    }
+    size_t size = sizeof(struct card) * SOLITAIRE_DECK_SIZE;
+    deck->arena = arena;
+    deck->cards = arena ? arena_alloc(arena, size) : malloc(size);
+    if (deck->cards == NULL)
+        die("malloc");
 }
 
+// Lays the cards out in the order of ids, as written by deal_permute, reusing
+// the card array
 static inline void
-_deck_shuffle(struct deck *deck)
+_deck_generate(struct deck *deck, uint8_t const *ids)
 {
-    srand(time(NULL));
+    deck->initialized = true;
+    deck->len = SOLITAIRE_DECK_SIZE;
+
     int i;
     for (i = 0; i < deck->len; ++i) {
-        int j = rand() / (RAND_MAX / (deck->len - i) + 1);
-        struct card t = deck->cards[j];
-        deck->cards[j] = deck->cards[i];
-        deck->cards[i] = t;
+        struct card *card = deck->cards + i;
+        card->suit = ids[i] / RANK_MAX;
+        card->rank = ids[i] % RANK_MAX;
+        card->color = !(card->suit & 0x1);
+        card->face_up = false;
+        card->location = LOC_DECK;
+        card->pile = NULL;
     }
 }
 
-static inline int
-_deck_generate_standard(struct deck *deck)
+// Records where each card ended up in the card array
+static inline void
+_deck_index(struct deck *deck)
 {
-    enum card_suit suit;
-    enum card_rank rank;
-
-    deck->initialized = true;
-    deck->len = SOLITAIRE_DECK_SIZE;
-    deck->cards = malloc(sizeof(struct card) * (size_t)deck->len);
-    struct card *card = deck->cards;
-
-    for (suit = SUIT_SPADE; suit < SUIT_MAX; ++suit) {
-        for (rank = RANK_A; rank < RANK_MAX; ++rank) {
-            card->suit = suit;
-            card->rank = rank;
-            card->color = !(card->suit & 0x1);
-            card->face_up = false;
-            card->location = LOC_DECK;
-            card++;
-        }
+    int i;
+    for (i = 0; i < SOLITAIRE_DECK_SIZE; ++i) {
+        struct card *card = deck->cards + i;
+        deck->index[card->suit][card->rank] = (uint8_t)i;
     }
-
-    return true;
 }
 
-static inline bool
-_move_all_cards(struct pile *src_pile, struct pile *dst_pile)
+/*
+ * Turns the whole of src_pile over onto dst_pile, which must be empty, for a
+ * recycle of the waste or its undo. Only the index bytes are reversed: the
+ * cards are stamped lazily by _pile_card, and as every card flips between the
+ * waste face up and the stock face down, the change to the hash is the talon
+ * key _pile_push and _pile_pop keep for exactly the cards of the two piles.
+ */
+static inline void
+_talon_recycle(struct pile *src_pile, struct pile *dst_pile)
 {
-    if (list_empty(&src_pile->list))
-        return false;
-
-    int count = pile_count(src_pile);
+    assert(_PILE_IS_TALON(src_pile) && _PILE_IS_TALON(dst_pile));
+    assert(pile_empty(dst_pile));
+    int n = src_pile->len;
     int i;
-    for (i = 0; i < count; ++i) {
-        struct card *card = pile_top_card(src_pile);
-        card->face_up = !card->face_up;
-        list_move(src_pile->list.next, &dst_pile->list);
-    }
-    _pile_set_card_locations(dst_pile);
-    _pile_set_card_piles(dst_pile);
-    dst_pile->len = src_pile->len;
+    for (i = 0; i < n; ++i)
+        dst_pile->cards[i] = src_pile->cards[n - 1 - i];
+    dst_pile->len = n;
     src_pile->len = 0;
-    return true;
+    dst_pile->field->hash ^= dst_pile->field->talon;
 }
 
 static inline bool
@@ -394,52 +584,20 @@ _move_stock_to_waste(struct pile *stock, struct pile *waste)
     assert(_pile_is_waste(waste));
 
     // CASE: Stock is empty. Move all cards back from waste to stock.
-    if (list_empty(&stock->list)) {
+    if (pile_empty(stock)) {
         // CASE: Waste is empty too. Can't do anything.
-        if (list_empty(&waste->list))
+        if (pile_empty(waste))
             return false;
 
-        _move_all_cards(waste, stock);
-        /*
-        int count = pile_count(waste);
-        int i;
-        for (i = 0; i < count; ++i) {
-            struct card *card = pile_top_card(waste);
-            card->face_up = false;
-            list_move(waste->list.next, &stock->list);
-        }
-        _pile_set_card_locations(stock);
-        _pile_set_card_piles(stock);
-        stock->len = waste->len;
-        waste->len = 0;
-        */
-
-        // This method moves the cards in revered order.
-        // TODO: Consider moving the cards to the stock as a queue, and to the
-        // pile as a stack. When the pile is empty, list_plice_init can be used
-        // to moved the whole pile in fewer operations. However, the cards will
-        // still need to be iterated through in order to set locations and piles
-        /*
-        list_splice_init(&waste->list, &stock->list);
-        struct card *card;
-        list_for_each_entry(card, &stock->list, list) {
-            card->face_up = false;
-            card->location = LOC_STOCK;
-            card->pile = stock;
-        }
-        stock->len = waste->len;
-        waste->len = 0;
-        */
+        _talon_recycle(waste, stock);
         return true;
     }
 
-    list_move(stock->list.next, &waste->list);
-    pile_top_flip_up(waste);
-    _pile_top_set_location(waste);
-    _pile_top_set_pile(waste);
-    waste->len++;
-    stock->len--;
-    assert(stock->len >= 0);
+    // The card turns face up as it lands on the waste. The stock and waste
+    // still hold the same cards, so no move dead_end_check looks for changed.
+    uint16_t dirty = stock->field->dirty;
+    _pile_push(waste, _pile_pop(stock));
+    stock->field->dirty = dirty;
     return true;
 }
 
@@ -447,54 +605,20 @@ static inline void
 _move_stack(struct card *src_card, struct pile *dst_pile)
 {
     assert(src_card != NULL);
-    if (!src_card->face_up) {
-        fprintf(stderr, "Card is not face up %s\n", __func__);
-        return;
-    }
+    assert(src_card->face_up);
 
     struct pile *src_pile = src_card->pile;
-    if (!_pile_is_tableau(src_pile)) {
-        fprintf(stderr, "Source pile is not a tableau %s\n", __func__);
-        return;
-    }
-
-    struct list_head temp = { 0 };
-    INIT_LIST_HEAD(&temp);
-    list_cut_position(&temp, &src_pile->list, &src_card->list);
-    list_splice_init(&temp, &dst_pile->list);
-    _pile_set_card_locations(dst_pile);
-    _pile_set_card_piles(dst_pile);
-}
+    assert(_pile_is_tableau(src_pile));
 
-static inline void
-_move_card_to_pile(struct card *src_card, struct pile *dst_pile)
-{
-    assert(src_card != NULL);
-    /*
-    if (!src_card->face_up) {
-        fprintf(stderr, "Card is not face up %s\n", __func__);
-        return;
-    }
-    */
-    list_move(&src_card->list, &dst_pile->list);
-    src_card->pile = dst_pile;
-    src_card->location = dst_pile->location;
-    src_card->pile->len--;
-    dst_pile->len++;
+    _pile_move_top(src_pile, dst_pile, src_pile->len - src_card->pos);
 }
 
 static inline void
 _move_card(struct card *src, struct card *dst)
 {
-    if (!(src->face_up && dst->face_up)) {
-        fprintf(stderr, "Card is not face up %s\n", __func__);
-        return;
-    }
-    list_move(&src->list, &dst->pile->list);
-    src->pile = dst->pile;
-    src->location = dst->location;
-    src->pile->len--;
-    dst->pile->len++;
+    assert(src->face_up && dst->face_up);
+    assert(card_is_top_of_pile(src));
+    _pile_push(dst->pile, _pile_pop(src->pile));
 }
 
 /**
@@ -513,35 +637,31 @@ die(char *msg)
 struct card *
 pile_top_card(struct pile *pile)
 {
-    return list_first_entry_or_null(&pile->list, struct card, list);
+    if (pile->len == 0)
+        return NULL;
+    return _pile_card(pile, pile->len - 1);
 }
 
 struct card *
 pile_last_card(struct pile *pile)
 {
-    return list_last_entry_or_null(&pile->list, struct card, list);
+    if (pile->len == 0)
+        return NULL;
+    return _pile_card(pile, 0);
 }
 
 struct card *
 pile_get_nth_card(struct pile *pile, int n)
 {
-    if (pile_empty(pile))
+    if (n < 0 || n >= pile->len)
         return NULL;
-
-    struct card *card;
-    int i = 0;
-    list_for_each_entry(card, &pile->list, list) {
-        if (i == n)
-            return card;
-        i++;
-    }
-    return NULL;
+    return _pile_card(pile, pile->len - 1 - n);
 }
 
 bool
 pile_empty(struct pile *pile)
 {
-    return list_empty(&pile->list);
+    return pile->len == 0;
 }
 
 bool
@@ -556,25 +676,17 @@ pile_top_is_face_up(struct pile *pile)
 struct card *
 pile_last_face_up_card(struct pile *pile)
 {
-    struct card *card;
-    if (pile_empty(pile))
-        return NULL;
-    list_for_each_entry_reverse(card, &pile->list, list)
-        if (card->face_up)
-            return card;
+    int i;
+    for (i = 0; i < pile->len; ++i)
+        if (_pile_card(pile, i)->face_up)
+            return _pile_card(pile, i);
     return NULL;
 }
 
 int
 pile_count(struct pile *pile)
 {
-    if (pile_empty(pile))
-        return 0;
-    int i = 0;
-    struct card *card;
-    list_for_each_entry(card, &pile->list, list)
-        i++;
-    return i;
+    return pile->len;
 }
 
 /*
@@ -608,7 +720,8 @@ struct card *
 pile_search(struct pile *pile, enum card_suit suit, enum card_rank rank)
 {
     struct card *card;
-    list_for_each_entry(card, &pile->list, list)
+    int i;
+    pile_for_each_card(card, i, pile)
         if (card->suit == suit && card->rank == rank)
             return card;
     return NULL;
@@ -617,17 +730,9 @@ pile_search(struct pile *pile, enum card_suit suit, enum card_rank rank)
 bool
 pile_has_card(struct pile *pile, struct card *card)
 {
-    struct card *cptr;
-    if (list_empty(&pile->list))
-        return false;
-
     if (card == NULL)
         return false;
-
-    list_for_each_entry(cptr, &pile->list, list)
-        if (card == cptr)
-            return true;
-    return false;
+    return card->pile == pile;
 }
 
 void
@@ -636,58 +741,119 @@ pile_top_flip_up(struct pile *pile)
     struct card *card = pile_top_card(pile);
     if (card == NULL)
         return;
-    card->face_up = true;
-    /*
     if (card->face_up == false)
-        card->face_up = true;
-    */
+        card_flip(card);
 }
 
 void
 card_flip(struct card *card)
 {
+    struct pile *pile = card->pile;
+    // The face of a stock or waste card is set by its pile
+    assert(pile == NULL || !_PILE_IS_TALON(pile));
+    if (pile != NULL)
+        pile->field->hash ^= _zobrist_key(card, pile);
     card->face_up = !card->face_up;
+    if (pile != NULL) {
+        pile->field->hash ^= _zobrist_key(card, pile);
+        _pile_dirty(pile);
+    }
 }
 
+// Returns the card directly beneath card in its pile, or NULL at the bottom.
 struct card *
 card_next(struct card *card)
 {
-    struct list_head *head = card->list.next;
-    struct list_head *pos = head->next;
-    if (pos != head)
-        return list_entry(card->list.next, struct card, list);
-    return NULL;
+    if (card->pos == 0)
+        return NULL;
+    return _pile_card(card->pile, card->pos - 1);
 }
 
+// Returns the card directly on top of card in its pile, or NULL at the top.
 struct card *
 card_prev(struct card *card)
 {
-    struct list_head *head = card->list.prev;
-    struct list_head *pos = head->prev;
-    if (pos != head)
-        return list_entry(card->list.prev, struct card, list);
-    return NULL;
+    if (card->pos >= card->pile->len - 1)
+        return NULL;
+    return _pile_card(card->pile, card->pos + 1);
 }
 
 bool
 card_is_top_of_pile(struct card *card)
 {
-    return card == pile_top_card(card->pile);
+    return card->pos == card->pile->len - 1;
+}
+
+size_t
+card_str(struct card const *card, char *buf)
+{
+    buf[0] = card == NULL ? '-' : _rank_chars[card->rank];
+    buf[1] = card == NULL ? '-' : _suit_chars[card->suit];
+    buf[2] = '\0';
+    return 2;
+}
+
+bool
+card_parse(char const *str, enum card_suit *suit, enum card_rank *rank)
+{
+    if (str[0] == '\0' || str[1] == '\0' || str[2] != '\0')
+        return false;
+    char const *r = strchr(_rank_chars, str[0]);
+    char const *s = strchr(_suit_chars, str[1]);
+    if (r == NULL || s == NULL)
+        return false;
+    *rank = (enum card_rank)(r - _rank_chars);
+    *suit = (enum card_suit)(s - _suit_chars);
+    return true;
 }
 
 void
 deck_init(struct deck *deck)
 {
-    _deck_generate_standard(deck);
-    _deck_shuffle(deck);
-    _deck_enqueue(deck);
+    // Mix the clock with the process and the deck, so decks made in the same
+    // second still get different deal numbers.
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint64_t state = (uint64_t)ts.tv_sec * 1000000000ULL
+        + (uint64_t)ts.tv_nsec;
+    state ^= ((uint64_t)getpid() << 32) ^ (uint64_t)(uintptr_t)deck;
+    deck_init_seeded(deck, rng_splitmix64(&state));
+}
+
+void
+deck_init_seeded(struct deck *deck, uint64_t seed)
+{
+    deck_init_arena(deck, seed, NULL);
+}
+
+void
+deck_init_arena(struct deck *deck, uint64_t seed, struct arena *arena)
+{
+    uint8_t ids[SOLITAIRE_DECK_SIZE];
+    deal_permute(seed, ids);
+    _deck_alloc(deck, arena);
+    _deck_generate(deck, ids);
+    _deck_index(deck);
+    deck->seed = seed;
+}
+
+struct card *
+deck_search(struct deck *deck, enum card_suit suit, enum card_rank rank)
+{
+    if (suit < SUIT_SPADE || suit >= SUIT_MAX)
+        return NULL;
+    if (rank < RANK_A || rank >= RANK_MAX)
+        return NULL;
+    return deck->cards + deck->index[suit][rank];
 }
 
 void
 deck_destroy(struct deck *deck)
 {
     if (deck->cards != NULL) {
-        free(deck->cards);
+        // Arena memory goes back with arena_reset
+        if (deck->arena == NULL)
+            free(deck->cards);
         deck->cards = NULL;
         deck->len = 0;
         deck->initialized = false;
@@ -701,34 +867,27 @@ field_search(
     enum card_rank rank
     )
 {
-    struct card *card = NULL;
-    if ((card = pile_search(&field->stock, suit, rank)) != NULL) {
+    struct card *card = deck_search(field->deck, suit, rank);
+    if (card == NULL || card->pile == NULL || !_PILE_IS_TALON(card->pile))
         return card;
-    }
-
-    if ((card = pile_search(&field->waste, suit, rank)) != NULL) {
-        return card;
-    }
 
+    // A stock or waste card may have been recycled since it was last stamped,
+    // in which case it is in the other pile
+    struct pile *pile = card->pile;
+    uint8_t idx = (uint8_t)(card - pile->base);
+    if (card->pos < pile->len && pile->cards[card->pos] == idx)
+        return _pile_card(pile, card->pos);
+    pile = pile == &field->stock ? &field->waste : &field->stock;
     int i;
-    for (i = 0; i < NUM_FOUNDATION; ++i) {
-        if ((card =
-                pile_search(&field->foundations[i], suit, rank)) != NULL) {
-            return card;
-        }
-    }
-
-    for (i = 0; i < NUM_TABLEAU; ++i) {
-        if ((card = pile_search(&field->tableaus[i], suit, rank)) != NULL) {
-            return card;
-        }
-    }
-
-    return NULL;
+    for (i = 0; i < pile->len; ++i)
+        if (pile->cards[i] == idx)
+            return _pile_card(pile, i);
+    assert(false);
+    return card;
 }
 
 // MOVE FUNCTIONS
-static inline bool
+static inline enum move_status
 _move_pile_to_pile_single(struct pile *src_pile, struct pile *dst_pile)
 {
     assert(!pile_empty(src_pile));
@@ -736,44 +895,32 @@ _move_pile_to_pile_single(struct pile *src_pile, struct pile *dst_pile)
     if (!pile_empty(dst_pile))
         assert(pile_top_is_face_up(dst_pile));
     struct card *src_card = pile_top_card(src_pile);
-    if (!_move_valid(src_card, dst_pile))
-        return false;
+    enum move_status status = _move_check(src_card, dst_pile);
+    if (status != MOVE_OK)
+        return status;
 
-    list_move(src_pile->list.next, &dst_pile->list);
-    _pile_top_set_location(dst_pile);
-    _pile_top_set_pile(dst_pile);
-    src_pile->len--;
-    dst_pile->len++;
-    return true;
+    _pile_push(dst_pile, _pile_pop(src_pile));
+    return MOVE_OK;
 }
 
-bool
-move_card_to_pile(struct card *src_card, struct pile *dst_pile)
+enum move_status
+move_card_to_pile_quiet(struct card *src_card, struct pile *dst_pile)
 {
-    assert(src_card != NULL);
-    if (!src_card->face_up) {
-        fprintf(stderr, "src_card is not face up! %s\n", __func__);
-        return false;
-    }
-    if (dst_pile->location < LOC_TAB0) {
-        fprintf(stderr,
-            "dst pile is not a foundation or tableau: %d! %s\n",
-            dst_pile->location,
-            __func__
-            );
-        return false;
-    }
+    if (src_card == NULL)
+        return MOVE_ERR_NO_CARD;
+    if (!src_card->face_up)
+        return MOVE_ERR_NOT_FACE_UP;
+    if (dst_pile->location < LOC_TAB0)
+        return MOVE_ERR_DST_PILE;
     struct card *dst_card = pile_top_card(dst_pile);
 
     // Destination pile is not empty, so move the cards using move_card_to_card
     if (dst_card != NULL)
-        return move_card_to_card(src_card, dst_card);
+        return move_card_to_card_quiet(src_card, dst_card);
 
     struct pile *src_pile = src_card->pile;
-    if (src_pile->location < LOC_WASTE) {
-        fprintf(stderr, "src_pile is < LOC_WASTE! %s\n", __func__);
-        return false;
-    }
+    if (src_pile->location < LOC_WASTE)
+        return MOVE_ERR_SRC_PILE;
 
     // If the moving card is on top, then the card can be moved with the
     // _move_pile_to_pile_single functions.
@@ -782,64 +929,55 @@ move_card_to_pile(struct card *src_card, struct pile *dst_pile)
 
     // If both piles are tableau, can move stack
     if (_pile_is_tableau(src_pile) && _pile_is_tableau(dst_pile)) {
+        enum move_status status = _tableau_move_check(src_card, NULL);
+        if (status != MOVE_OK)
+            return status;
         _move_stack(src_card, dst_pile);
-        return true;
+        return MOVE_OK;
     }
 
-    fprintf(stderr,
-        "Reached end of function %s without moving card!\n", __func__);
-
-    return false;
+    return MOVE_ERR_NOT_TOP;
 }
 
-bool
-move_card_to_card(struct card *src_card, struct card *dst_card)
+enum move_status
+move_card_to_card_quiet(struct card *src_card, struct card *dst_card)
 {
-    assert(src_card != NULL);
-    assert(dst_card != NULL);
+    enum move_status status;
+    if (src_card == NULL || dst_card == NULL)
+        return MOVE_ERR_NO_CARD;
 
-    if (!src_card->face_up) {
-        fprintf(stderr, "src card is not face up! %s\n", __func__);
-        return false;
-    }
+    if (!src_card->face_up)
+        return MOVE_ERR_NOT_FACE_UP;
 
-    if (!dst_card->face_up) {
-        fprintf(stderr, "dst card is not face up! %s\n", __func__);
-        return false;
-    }
+    if (!dst_card->face_up)
+        return MOVE_ERR_DST_NOT_FACE_UP;
 
-    if (src_card->location < LOC_WASTE) {
-        fprintf(stderr,
-            "src location is not < LOC_WASTE! %s\n", __func__);
-        return false;
-    }
+    if (src_card->location < LOC_WASTE)
+        return MOVE_ERR_SRC_PILE;
 
-    if (src_card == dst_card) {
-        fprintf(stderr,
-            "src card is dst card!%s\n", __func__);
-        return false;
-    }
+    if (src_card == dst_card)
+        return MOVE_ERR_SAME_CARD;
 
     // move card to foundation
     if (_pile_is_foundation(dst_card->pile)) {
-        if (!_foundation_move_valid(src_card, dst_card)) {
-            fprintf(stderr, "!_foundation_move_valid! %s\n", __func__);
-            return false;
-        }
+        if (!card_is_top_of_pile(src_card))
+            return MOVE_ERR_NOT_TOP;
+        status = _foundation_move_check(src_card, dst_card);
+        if (status != MOVE_OK)
+            return status;
         _move_card(src_card, dst_card);
-        return true;
+        return MOVE_OK;
     }
 
     // move card to tableau
     if (_pile_is_tableau(dst_card->pile)) {
-        if (!_tableau_move_valid(src_card, dst_card)) {
-            fprintf(stderr, "!_tableau_move_valid! %s\n", __func__);
-            return false;
-        }
+        status = _tableau_move_check(src_card, dst_card);
+        if (status != MOVE_OK)
+            return status;
         // If card is top of pile, move to tableau regardless of src location
         if (card_is_top_of_pile(src_card)) {
             _move_card(src_card, dst_card);
-            return true;
+            return MOVE_OK;
         }
 
         // If the card is from a tableau, and has not already been moved by the
@@ -847,36 +985,256 @@ move_card_to_card(struct card *src_card, struct card *dst_card)
         // must be moved
         if (_pile_is_tableau(src_card->pile)) {
             _move_stack(src_card, dst_card->pile);
-            return true;
+            return MOVE_OK;
         }
+
+        return MOVE_ERR_NOT_TOP;
     }
 
-    fprintf(stderr, "Reached end of %s without moving card!\n", __func__);
-    return false;
+    return MOVE_ERR_DST_PILE;
 }
 
 bool
-deal_card(struct field *field)
+move_card_to_pile(struct card *src_card, struct pile *dst_pile)
 {
-    struct card *card = pile_top_card(&field->stock);
-    if (!_move_stock_to_waste(&field->stock, &field->waste)) {
+    enum move_status status = move_card_to_pile_quiet(src_card, dst_pile);
+    if (status != MOVE_OK) {
+        fprintf(stderr, "%s! %s\n", move_status_str(status), __func__);
         return false;
     }
-    _history_push(field, card, &field->stock, &field->waste);
-    // return _move_stock_to_waste(&field->stock, &field->waste);
     return true;
 }
 
-
-// FIELD FUNCTIONS
-
-static inline void
-_field_history_init(struct field *field)
-{
+bool
+move_card_to_card(struct card *src_card, struct card *dst_card)
+{
+    enum move_status status = move_card_to_card_quiet(src_card, dst_card);
+    if (status != MOVE_OK) {
+        fprintf(stderr, "%s! %s\n", move_status_str(status), __func__);
+        return false;
+    }
+    return true;
+}
+
+bool
+deal_card(struct field *field)
+{
+    bool recycle = pile_empty(&field->stock);
+    if (!_move_stock_to_waste(&field->stock, &field->waste)) {
+        return false;
+    }
+    if (recycle)
+        _history_push(field, &field->waste, &field->stock,
+            field->stock.len, false, true);
+    else
+        _history_push(field, &field->stock, &field->waste, 1, false, false);
+    return true;
+}
+
+// MOVE GENERATION
+
+// Appends a move to the buffer if there is room, and always counts it
+#define _GEN_MOVE(moves, cnt, max, s, d, n) do { \
+    if ((cnt) < (max)) \
+        (moves)[(cnt)] = (struct card_move){ (s), (d), (n) }; \
+    (cnt)++; \
+} while (0)
+
+/*
+ * Destinations are found for all eleven piles at once. _gen_tops lays out the
+ * top card ids of the tableaus in lanes 0 to 6 and of the foundations in lanes
+ * 7 to 10, CARD_ID_NONE standing for an empty pile. A card goes onto a
+ * tableau topped by one of its two parents and onto a foundation topped by
+ * the card below it in its suit, where a king's parents and an ace's card
+ * below are both CARD_ID_NONE, so one compare per wanted id covers every pile.
+ */
+#define _GEN_LANES 16
+#define _GEN_FOUND0 NUM_TABLEAU
+#define _GEN_TABLEAUS ((1u << NUM_TABLEAU) - 1)
+#define _GEN_FOUNDATIONS (((1u << NUM_FOUNDATION) - 1) << _GEN_FOUND0)
+#define _GEN_UNUSED 0xfe    // Neither a card id nor CARD_ID_NONE
+
+static inline uint8_t
+_gen_top(struct pile *pile)
+{
+    if (pile->len == 0)
+        return CARD_ID_NONE;
+    return (uint8_t)card_id(pile->base + pile->cards[pile->len - 1]);
+}
+
+static inline void
+_gen_tops(struct field *field, uint8_t *tops)
+{
+    int i;
+    memset(tops, _GEN_UNUSED, _GEN_LANES);
+    for (i = 0; i < NUM_TABLEAU; ++i)
+        tops[i] = _gen_top(&field->tableaus[i]);
+    for (i = 0; i < NUM_FOUNDATION; ++i)
+        tops[_GEN_FOUND0 + i] = _gen_top(&field->foundations[i]);
+}
+
+// Returns a bit per lane of tops that src_card can go onto
+static inline unsigned
+_gen_dsts(uint8_t const *tops, struct card *src_card)
+{
+    int id = card_id(src_card);
+    uint8_t const *parents = _tableau_parent_ids[id];
+    uint8_t below = src_card->rank == RANK_A ? CARD_ID_NONE : (uint8_t)(id - 1);
+
+#ifdef __SSE2__
+    __m128i v = _mm_loadu_si128((__m128i const *)tops);
+    __m128i tab = _mm_or_si128(
+        _mm_cmpeq_epi8(v, _mm_set1_epi8((char)parents[0])),
+        _mm_cmpeq_epi8(v, _mm_set1_epi8((char)parents[1])));
+    __m128i found = _mm_cmpeq_epi8(v, _mm_set1_epi8((char)below));
+    return ((unsigned)_mm_movemask_epi8(tab) & _GEN_TABLEAUS)
+        | ((unsigned)_mm_movemask_epi8(found) & _GEN_FOUNDATIONS);
+#else
+    unsigned dsts = 0;
+    int i;
+    for (i = 0; i < NUM_TABLEAU; ++i)
+        if (tops[i] == parents[0] || tops[i] == parents[1])
+            dsts |= 1u << i;
+    for (i = _GEN_FOUND0; i < _GEN_FOUND0 + NUM_FOUNDATION; ++i)
+        if (tops[i] == below)
+            dsts |= 1u << i;
+    return dsts;
+#endif
+}
+
+// Emits a move of src_card and everything on it to each pile in dsts, in pile
+// order. Only one foundation can take a given card.
+static inline int
+_gen_moves_to(
+    struct card *src_card,
+    unsigned dsts,
+    struct card_move *moves,
+    int cnt,
+    int max
+    )
+{
+    struct pile *src_pile = src_card->pile;
+    int n = src_pile->len - src_card->pos;
+    int i;
+
+    // Most cards have nowhere to go
+    if (dsts == 0)
+        return cnt;
+    for (i = 0; i < NUM_TABLEAU; ++i)
+        if (dsts & (1u << i))
+            _GEN_MOVE(moves, cnt, max, src_pile->location, LOC_TAB0 + i, n);
+    for (i = 0; i < NUM_FOUNDATION; ++i) {
+        if (dsts & (1u << (_GEN_FOUND0 + i))) {
+            _GEN_MOVE(moves, cnt, max, src_pile->location, LOC_FOUND0 + i, 1);
+            break;
+        }
+    }
+    return cnt;
+}
+
+int
+field_gen_moves(struct field *field, struct card_move *moves, int max)
+{
+    uint8_t tops[_GEN_LANES];
+    int cnt = 0;
+    int i;
+    int j;
+    struct card *card;
+
+    _gen_tops(field, tops);
+
+    // Waste top to tableaus and foundations
+    if ((card = pile_top_card(&field->waste)) != NULL)
+        cnt = _gen_moves_to(card, _gen_dsts(tops, card), moves, cnt, max);
+
+    for (i = 0; i < NUM_TABLEAU; ++i) {
+        struct pile *pile = &field->tableaus[i];
+        unsigned others = _GEN_TABLEAUS & ~(1u << i);
+        if (pile_empty(pile))
+            continue;
+
+        // Tableau top to foundations
+        card = pile_top_card(pile);
+        if (card->face_up)
+            cnt = _gen_moves_to(card, _gen_dsts(tops, card) & _GEN_FOUNDATIONS,
+                moves, cnt, max);
+
+        // Every face up card, along with the stack on top of it, to tableaus
+        for (j = pile->len - 1; j >= 0; --j) {
+            card = _pile_card(pile, j);
+            if (!card->face_up)
+                break;
+            cnt = _gen_moves_to(card, _gen_dsts(tops, card) & others,
+                moves, cnt, max);
+        }
+    }
+
+    // Foundation tops back down to tableaus
+    for (i = 0; i < NUM_FOUNDATION; ++i)
+        if ((card = pile_top_card(&field->foundations[i])) != NULL)
+            cnt = _gen_moves_to(card, _gen_dsts(tops, card) & _GEN_TABLEAUS,
+                moves, cnt, max);
+
+    // Deal, or recycle the waste once the stock runs out
+    if (!pile_empty(&field->stock))
+        _GEN_MOVE(moves, cnt, max, LOC_STOCK, LOC_WASTE, 1);
+    else if (!pile_empty(&field->waste))
+        _GEN_MOVE(moves, cnt, max, LOC_WASTE, LOC_STOCK, field->waste.len);
+
+    return cnt;
+}
+
+bool
+field_apply_move(struct field *field, struct card_move *move)
+{
+    // CASE: Deal, only while the stock has cards
+    if (move->src == LOC_STOCK) {
+        if (move->dst != LOC_WASTE || pile_empty(&field->stock))
+            return false;
+        return deal_card(field);
+    }
+
+    // CASE: Recycle, only once the stock has run out
+    if (move->dst == LOC_STOCK) {
+        if (move->src != LOC_WASTE || !pile_empty(&field->stock))
+            return false;
+        return deal_card(field);
+    }
+
+    struct pile *src_pile = field_pile(field, move->src);
+    struct pile *dst_pile = field_pile(field, move->dst);
+    if (src_pile == NULL || dst_pile == NULL || src_pile == dst_pile)
+        return false;
+    if (move->cnt < 1 || move->cnt > src_pile->len)
+        return false;
+
+    // Only tableau to tableau moves can carry a stack
+    if (move->cnt > 1
+        && !(_pile_is_tableau(src_pile) && _pile_is_tableau(dst_pile)))
+        return false;
+
+    struct card *src_card = _pile_card(src_pile, src_pile->len - move->cnt);
+    if (!src_card->face_up || !_move_valid(src_card, dst_pile))
+        return false;
+
+    _pile_move_top(src_pile, dst_pile, move->cnt);
+    bool flipped = _pile_flip_top(src_pile);
+    _history_push(field, src_pile, dst_pile, move->cnt, flipped, false);
+    return true;
+}
+
+
+// FIELD FUNCTIONS
+
+static inline void
+_field_history_init(struct field *field, struct arena *arena)
+{
     struct history *hist = &field->history;
+    size_t size = sizeof(struct card_action) * 32;
     hist->cnt = 0;
     hist->cap = 32;
-    hist->actions = malloc(sizeof(struct card_action) * (size_t)hist->cap);
+    hist->arena = arena;
+    hist->actions = arena ? arena_alloc(arena, size) : malloc(size);
     if (hist->actions == NULL)
         die("malloc");
 }
@@ -887,131 +1245,202 @@ _field_history_destroy(struct field *field)
     struct history *hist = &field->history;
     if (hist->actions == NULL)
         return;
-    free(hist->actions);
+    if (hist->arena == NULL)
+        free(hist->actions);
     memset(hist, 0, sizeof(struct history));
 }
 
+// Doubles the history. An arena can not grow a block in place, so the old one
+// is left to the next arena_reset.
 static inline void
-_field_snapshot(struct field *field, struct card_action *act)
+_field_history_grow(struct field *field)
 {
     struct history *hist = &field->history;
-
-
-    if (hist->cnt >= hist->cap) {
-        hist->cap *= 2;
-        hist->actions = realloc(
-            hist->actions,
-            sizeof(struct card_action) * (size_t)hist->cap
-            );
+    size_t size = sizeof(struct card_action) * (size_t)hist->cap * 2;
+    struct card_action *actions;
+
+    if (hist->arena != NULL) {
+        actions = arena_alloc(hist->arena, size);
+        if (actions != NULL)
+            memcpy(actions, hist->actions,
+                sizeof(struct card_action) * (size_t)hist->cnt);
+    } else {
+        actions = realloc(hist->actions, size);
     }
+    if (actions == NULL)
+        die("realloc");
 
-    hist->actions[hist->cnt++] = *act;
+    hist->actions = actions;
+    hist->cap *= 2;
 }
 
-static inline struct card_action
-_action_store(struct card *card, struct pile *src, struct pile *dst)
+static inline void
+_field_snapshot(struct field *field, struct card_action *act)
 {
-    struct card_action act = { card, src, dst };
-    return act;
+    struct history *hist = &field->history;
+    if (hist->cnt >= hist->cap)
+        _field_history_grow(field);
+    hist->actions[hist->cnt++] = *act;
 }
 
-static inline struct card_action
-_history_pop(struct field *field)
+static inline void
+_field_history_reserve(struct field *field, int cnt)
 {
-    // struct history *hist = &field->history;
-    if (field->history.cnt < 1)
-        return _action_store(NULL, NULL, NULL);
-    return field->history.actions[--field->history.cnt];
+    while (field->history.cap < cnt)
+        _field_history_grow(field);
 }
 
 static inline void
 _history_push(
     struct field *field,
-    struct card *card,
     struct pile *src,
-    struct pile *dst
+    struct pile *dst,
+    int cnt,
+    bool flipped,
+    bool recycle
     )
 {
-    struct card_action act = _action_store(card, src, dst);
+    struct card_action act = {
+        .src = src->location - LOC_STOCK,
+        .dst = dst->location - LOC_STOCK,
+        .cnt = cnt,
+        .flipped = flipped,
+        .recycle = recycle,
+    };
     _field_snapshot(field, &act);
 }
 
+void
+field_history_copy(struct field *dst, struct field *src)
+{
+    _field_history_reserve(dst, src->history.cnt);
+    memcpy(dst->history.actions, src->history.actions,
+        sizeof(struct card_action) * (size_t)src->history.cnt);
+    dst->history.cnt = src->history.cnt;
+}
 
 void
-undo_move(struct field *field)
+field_freeze(struct field *field, struct field_frozen *frozen)
 {
-    struct card_action act = _history_pop(field);
-    if (act.card == NULL && act.src == NULL) {
-        fprintf(stderr, "No history to undo %s\n", __func__);
+    int cnt = field->history.cnt;
+    frozen->seed = field->deck->seed;
+    frozen->cnt = cnt;
+    frozen->actions = NULL;
+    field_pack(field, &frozen->pack);
+    if (cnt == 0)
         return;
-    }
+    frozen->actions = malloc(sizeof(struct card_action) * (size_t)cnt);
+    if (frozen->actions == NULL)
+        die("malloc");
+    memcpy(frozen->actions, field->history.actions,
+        sizeof(struct card_action) * (size_t)cnt);
+}
 
-    if (act.card == NULL && act.src->location == LOC_STOCK) {
-        _move_all_cards(&field->stock, &field->waste);
-        return;
+bool
+field_thaw(struct field *field, struct deck *deck, struct field_frozen *frozen)
+{
+    deck_init_seeded(deck, frozen->seed);
+    if (!field_unpack(field, deck, &frozen->pack)) {
+        deck_destroy(deck);
+        return false;
     }
+    _field_history_reserve(field, frozen->cnt);
+    if (frozen->cnt > 0)
+        memcpy(field->history.actions, frozen->actions,
+            sizeof(struct card_action) * (size_t)frozen->cnt);
+    field->history.cnt = frozen->cnt;
+    field_frozen_destroy(frozen);
+    return true;
+}
 
-    act.src->len++;
-    act.dst->len--;
-    _move_card_to_pile(act.card, act.src);
-    struct card *card = card_next(act.card);
-    if (card != NULL)
-        card_flip(card);
+void
+field_frozen_destroy(struct field_frozen *frozen)
+{
+    free(frozen->actions);
+    frozen->actions = NULL;
+    frozen->cnt = 0;
 }
 
 void
-field_init(struct field *field, struct deck *deck)
+undo_move(struct field *field)
 {
-    memset(field, 0, sizeof(struct field));
-    field->deck = deck;
+    if (field->history.cnt < 1) {
+        fprintf(stderr, "No history to undo %s\n", __func__);
+        return;
+    }
 
-    _field_history_init(field);
+    struct card_action act = field->history.actions[--field->history.cnt];
+    struct pile *src = field_pile(field, LOC_STOCK + act.src);
+    struct pile *dst = field_pile(field, LOC_STOCK + act.dst);
 
-    // Initialize stock list head
-    INIT_LIST_HEAD(&field->stock.list);
-    field->stock.location = LOC_STOCK;
+    // The stock goes back to the waste, turned face up again
+    if (act.recycle) {
+        _talon_recycle(dst, src);
+        return;
+    }
 
+    // Turn the card uncovered by the move back face down
+    if (act.flipped)
+        card_flip(pile_top_card(src));
 
-    // Initialize waste list head
-    INIT_LIST_HEAD(&field->waste.list);
-    field->waste.location = LOC_WASTE;
+    // A dealt card goes back into the stock face down by itself, and as with
+    // the deal no move dead_end_check looks for changed
+    uint16_t dirty = field->dirty;
+    _pile_move_top(dst, src, act.cnt);
+    if (_PILE_IS_TALON(src) && _PILE_IS_TALON(dst))
+        field->dirty = dirty;
+}
 
-    int i;
-    // Initialize all of the tableau list heads
-    for (i = 0; i < 7; ++i) {
-        INIT_LIST_HEAD(&field->tableaus[i].list);
-        field->tableaus[i].location = LOC_TAB0 + i;
-    }
-    // Initialize all of the foundation list heads
-    for (i = 0; i < 4; ++i) {
-        INIT_LIST_HEAD(&field->foundations[i].list);
-        field->foundations[i].location = LOC_FOUND0 + i;
-    }
+static inline void
+_field_piles_init(struct field *field, struct deck *deck)
+{
+    struct card *base = deck->cards;
+    field->dirty = (uint16_t)((1 << NUM_PILES) - 1);
+    _pile_init(&field->stock, base, field, STOCK_CAP, LOC_STOCK);
+    _pile_init(&field->waste, base, field, WASTE_CAP, LOC_WASTE);
 
-    // Move all cards from the deck to the stock
-    list_splice_tail_init(&deck->list, &field->stock.list);
-    field->stock.len = deck->len;
-    deck->len = 0;
-    _pile_set_card_locations(&field->stock);
-    _pile_set_card_piles(&field->stock);
+    int i;
+    for (i = 0; i < NUM_TABLEAU; ++i)
+        _pile_init(&field->tableaus[i],
+            base, field, TABLEAU_CAP, LOC_TAB0 + i);
+    for (i = 0; i < NUM_FOUNDATION; ++i)
+        _pile_init(&field->foundations[i],
+            base, field, FOUNDATION_CAP, LOC_FOUND0 + i);
+}
 
-    // Initialize tableaus
-    int j;
+struct pile *
+field_pile(struct field *field, enum card_location location)
+{
+    if (location == LOC_STOCK)
+        return &field->stock;
+    if (location == LOC_WASTE)
+        return &field->waste;
+    if (location >= LOC_TAB0 && location <= LOC_TAB6)
+        return &field->tableaus[location - LOC_TAB0];
+    if (location >= LOC_FOUND0 && location <= LOC_FOUND3)
+        return &field->foundations[location - LOC_FOUND0];
+    return NULL;
+}
 
-    for (i = NUM_TABLEAU - 1; i >= 0; --i) {
-        for (j = i; j >= 0; --j) {
-            // Move the top entry from the stock to each tableau
-            list_move(field->stock.list.next, &field->tableaus[i].list);
-                field->tableaus[j].cap = i;
-                field->tableaus[i].len++;
-                field->stock.len--;
-        }
-    }
+// Deals the deck out onto a field with nothing on it
+static inline void
+_field_deal(struct field *field, struct deck *deck)
+{
+    _field_piles_init(field, deck);
 
-    for (i = 0; i < NUM_TABLEAU; ++i) {
-        _pile_set_card_locations(&field->tableaus[i]);
-        _pile_set_card_piles(&field->tableaus[i]);
-    }
+    int i;
+    // Deal the tableaus from the front of the deck, the first card of the deck
+    // being the top of the stock.
+    int j;
+    int next = 0;
+    for (i = NUM_TABLEAU - 1; i >= 0; --i)
+        for (j = i; j >= 0; --j)
+            _pile_push(&field->tableaus[i], deck->cards + next++);
+
+    // The rest of the deck goes to the stock, so that deck order is deal order
+    for (i = deck->len - 1; i >= next; --i)
+        _pile_push(&field->stock, deck->cards + i);
+    deck->len = 0;
 
     for (i = 0; i < NUM_TABLEAU; ++i) {
         // card = pile_top_card(&field->tableaus[i]);
@@ -1020,16 +1449,144 @@ field_init(struct field *field, struct deck *deck)
     }
 
     // Move the top entry from stock to waste
-    // list_move(field->stock.list.next, &field->waste.list);
     deal_card(field);
 }
 
+void
+field_init(struct field *field, struct deck *deck)
+{
+    field_init_arena(field, deck, NULL);
+}
+
+void
+field_init_arena(struct field *field, struct deck *deck, struct arena *arena)
+{
+    memset(field, 0, sizeof(struct field));
+    field->deck = deck;
+    _field_history_init(field, arena);
+    _field_deal(field, deck);
+}
+
+void
+field_reset(struct field *field, uint64_t seed)
+{
+    struct deck *deck = field->deck;
+    struct history hist = field->history;
+    uint8_t ids[SOLITAIRE_DECK_SIZE];
+
+    deal_permute(seed, ids);
+    _deck_generate(deck, ids);
+    _deck_index(deck);
+    deck->seed = seed;
+
+    memset(field, 0, sizeof(struct field));
+    field->deck = deck;
+    field->history = hist;
+    field->history.cnt = 0;
+    _field_deal(field, deck);
+}
+
 void
 field_destroy(struct field *field)
 {
     _field_history_destroy(field);
 }
 
+uint64_t
+field_hash(struct field *field)
+{
+    return field->hash;
+}
+
+uint64_t
+field_hash_compute(struct field *field)
+{
+    uint64_t hash = 0;
+    int loc;
+    int i;
+    for (loc = LOC_STOCK; loc <= LOC_FOUND3; ++loc) {
+        struct pile *pile = field_pile(field, loc);
+        for (i = 0; i < pile->len; ++i)
+            hash ^= _zobrist_key(_pile_card(pile, i), pile);
+    }
+    return hash;
+}
+
+void
+field_pack(struct field *field, struct field_pack *pack)
+{
+    int n = 0;
+    int loc;
+    int i;
+    for (loc = LOC_STOCK; loc <= LOC_FOUND3; ++loc) {
+        struct pile *pile = field_pile(field, loc);
+        for (i = 0; i < pile->len; ++i) {
+            struct card *card = _pile_card(pile, i);
+            pack->cards[n++] = (uint8_t)(card_id(card)
+                | (card->face_up ? FIELD_PACK_FACE_UP : 0));
+        }
+        if (loc < LOC_FOUND3)
+            pack->lens[loc - LOC_STOCK] = (uint8_t)pile->len;
+    }
+    assert(n == SOLITAIRE_DECK_SIZE);
+}
+
+bool
+field_unpack(struct field *field, struct deck *deck, struct field_pack *pack)
+{
+    bool seen[SOLITAIRE_DECK_SIZE] = { 0 };
+    int i;
+
+    // Validate the whole pack before touching the field or the deck
+    int lens[NUM_PILES];
+    int total = 0;
+    for (i = 0; i < NUM_PILES - 1; ++i) {
+        lens[i] = pack->lens[i];
+        total += lens[i];
+    }
+    if (total > SOLITAIRE_DECK_SIZE)
+        return false;
+    lens[NUM_PILES - 1] = SOLITAIRE_DECK_SIZE - total;
+
+    for (i = 0; i < SOLITAIRE_DECK_SIZE; ++i) {
+        int id = pack->cards[i] & FIELD_PACK_ID_MASK;
+        if (pack->cards[i] & ~(FIELD_PACK_ID_MASK | FIELD_PACK_FACE_UP))
+            return false;
+        if (id >= SOLITAIRE_DECK_SIZE || seen[id])
+            return false;
+        seen[id] = true;
+        // Stock cards are face down and waste cards face up
+        bool face_up = (pack->cards[i] & FIELD_PACK_FACE_UP) != 0;
+        if (i < lens[0] + lens[1] && face_up != (i >= lens[0]))
+            return false;
+    }
+
+    memset(field, 0, sizeof(struct field));
+    field->deck = deck;
+    _field_piles_init(field, deck);
+
+    for (i = 0; i < NUM_PILES; ++i)
+        if (lens[i] > field_pile(field, LOC_STOCK + i)->cap)
+            return false;
+
+    _field_history_init(field, NULL);
+
+    int n = 0;
+    int loc;
+    for (loc = LOC_STOCK; loc <= LOC_FOUND3; ++loc) {
+        struct pile *pile = field_pile(field, loc);
+        for (i = 0; i < lens[loc - LOC_STOCK]; ++i) {
+            uint8_t byte = pack->cards[n++];
+            int id = byte & FIELD_PACK_ID_MASK;
+            struct card *card = deck_search(deck, id / RANK_MAX, id % RANK_MAX);
+            card->face_up = (byte & FIELD_PACK_FACE_UP) != 0;
+            _pile_push(pile, card);
+        }
+    }
+    deck->len = 0;
+    return true;
+}
+
 bool
 game_completion_check(struct field *field)
 {
@@ -1045,89 +1602,85 @@ game_completion_check(struct field *field)
     return true;
 }
 
-bool
-dead_end_check(struct field *field)
+// The cards pile can usefully move: the last face up card of a tableau, whose
+// move would turn the card under it, or for the stock every stock and waste
+// card, as dealing brings each of them round to the top
+static inline uint64_t
+_pile_offers(struct field *field, struct pile *pile)
 {
-    // 1. Check all tableaus for cards with unflipped neighbords that can be
-    // moved to other tableaus or foundations
-    // 2. Check all stock/waste cards for possible moves to tableaus and
-    // foundations to enable 1.
-    // 3. Check if foundations can be moved to tableaus to enable 1.
-
-
+    struct card *card;
+    uint64_t offers = 0;
     int i;
-    int j;
-
-    /*
-    struct card *kings[SUIT_MAX];
-    for (i = 0; i < SUIT_MAX; ++i) {
-        kings[i] = field_search(field, SUIT_SPADE + i, RANK_K);
-        if (kings[i] == NULL)
-            fprintf(stderr, "ERROR: Could not find one or more kings %s\n",
-                __func__);
-    }
-    */
-
-    struct card *src_card;
-    struct card *dst_card;
-    for (i = 0; i < NUM_TABLEAU; ++i) {
-        // If target is the bottom card, then we need to know if there are
-        // kings that can be moved to the spot
-        // If target is a king, then we need to see if there are any empty
-        // tableaus to move it to
-        if (pile_empty(&field->tableaus[i]))
-            continue;
-        src_card = pile_last_face_up_card(&field->tableaus[i]);
-        // card_print(src_card);
-        for (j = 0; j < NUM_TABLEAU; ++j) {
-            if (pile_empty(&field->tableaus[j]) && src_card->rank == RANK_K)
-                return false;
-
-            dst_card = pile_top_card(&field->tableaus[j]);
-            if (_tableau_move_valid(src_card, dst_card))
-                return false;
-        }
 
-        for (j = 0; j < NUM_FOUNDATION; ++j) {
-            dst_card = pile_top_card(&field->foundations[j]);
-            if (_foundation_move_valid(src_card, dst_card))
-                return false;
-        }
+    if (_pile_is_tableau(pile)) {
+        card = pile_last_face_up_card(pile);
+        return card ? 1ULL << card_id(card) : 0;
     }
+    pile_for_each_card(card, i, &field->stock)
+        offers |= 1ULL << card_id(card);
+    pile_for_each_card(card, i, &field->waste)
+        offers |= 1ULL << card_id(card);
+    return offers;
+}
 
-    if (!pile_empty(&field->stock)) {
-        list_for_each_entry(src_card, &field->stock.list, list) {
-            for (i = 0; i < NUM_TABLEAU; ++i) {
-                dst_card = pile_top_card(&field->tableaus[i]);
-                if (_tableau_move_valid(src_card, dst_card))
-                    return false;
-            }
-
-            for (i = 0; i < NUM_FOUNDATION; ++i) {
-                dst_card = pile_top_card(&field->foundations[i]);
-                if (_tableau_move_valid(src_card, dst_card))
-                    return false;
-            }
-        }
+// The cards _tableau_move_valid or _foundation_move_valid would let onto pile
+static inline uint64_t
+_pile_wants(struct pile *pile)
+{
+    struct card *top = pile_top_card(pile);
+    if (_pile_is_foundation(pile)) {
+        if (top == NULL)
+            return _ACES;
+        return top->rank == RANK_K ? 0 : 1ULL << (card_id(top) + 1);
     }
+    return top == NULL ? _KINGS : _tableau_children[card_id(top)];
+}
 
-    if (!pile_empty(&field->waste)) {
-        list_for_each_entry(src_card, &field->waste.list, list) {
-            for (i = 0; i < NUM_TABLEAU; ++i) {
-                dst_card = pile_top_card(&field->tableaus[i]);
-                if (_tableau_move_valid(src_card, dst_card))
-                    return false;
-            }
+bool
+dead_end_check(struct field *field)
+{
+    uint16_t dirty = field->dirty;
+    uint64_t offers = 0;
+    uint64_t wants = 0;
+    uint64_t tops = 0;
+    uint64_t found_wants = 0;
+    int i;
 
-            for (i = 0; i < NUM_FOUNDATION; ++i) {
-                dst_card = pile_top_card(&field->foundations[i]);
-                if (_tableau_move_valid(src_card, dst_card))
-                    return false;
+    if (dirty == 0)
+        return field->dead_end;
+
+    // The waste is looked at along with the stock
+    if (dirty & (1 << (LOC_WASTE - LOC_STOCK)))
+        dirty |= 1 << (LOC_STOCK - LOC_STOCK);
+    field->dirty = 0;
+
+    // Only the piles that changed are looked at again
+    for (i = 0; i < NUM_PILES; ++i) {
+        if (dirty & (1 << i)) {
+            struct pile *pile = field_pile(field, LOC_STOCK + i);
+            if (_pile_is_stock(pile) || _pile_is_tableau(pile))
+                field->offers[i] = _pile_offers(field, pile);
+            if (_pile_is_tableau(pile) || _pile_is_foundation(pile))
+                field->wants[i] = _pile_wants(pile);
+            if (_pile_is_tableau(pile)) {
+                struct card *top = pile_top_card(pile);
+                field->tops[i] = 0;
+                if (top != NULL && top->face_up)
+                    field->tops[i] = 1ULL << card_id(top);
             }
         }
+        offers |= field->offers[i];
+        wants |= field->wants[i];
+        tops |= field->tops[i];
+        if (i >= LOC_FOUND0 - LOC_STOCK)
+            found_wants |= field->wants[i];
     }
 
-    return true;
+    // A card is only ever in one pile, so some pile has a card another pile
+    // takes exactly when the unions meet. A tableau never takes its own card.
+    // The top card of a run can only usefully go to a foundation.
+    field->dead_end = (offers & wants) == 0 && (tops & found_wants) == 0;
+    return field->dead_end;
 }
 
 bool
@@ -1146,24 +1699,36 @@ game_over(struct field *field)
     return false;
 }
 
-// TODO: Add help message for -h flag
-// TODO: Write parser for easy commandline input
-// TODO: Implement auto move / auto completion
-bool
-user_input(struct field *field)
+char const *
+move_status_str(enum move_status status)
 {
-    char const *rankstr[] = {
-        "a", "2", "3", "4", "5", "6",
-        "7", "8", "9", "x", "j", "q", "k"
+    char const *msgs[] = {
+        "Move is valid",
+        "Card does not exist",
+        "Card is not face up",
+        "Destination card is not face up",
+        "Card can not be moved from that pile",
+        "Card can not be moved to that pile",
+        "Card can not be moved onto itself",
+        "Card is not on top of its pile",
+        "Only a King can go on an empty tableau",
+        "Only an Ace can go on an empty foundation",
+        "Colors are not opposite",
+        "Suits do not match",
+        "Destination must be one rank higher on a tableau or one lower on a "
+            "foundation",
     };
 
-    char const *suitstr[] = {
-        "s", "d", "c", "h"
-    };
+    if (status < MOVE_OK || status >= MOVE_STATUS_MAX)
+        return "Unknown move status";
+    return msgs[status];
+}
 
+// TODO: Implement auto move / auto completion
+bool
+user_input(struct field *field)
+{
     char buffer[256] = { 0 };
-    char move_src[256] = { 0 };
-    char move_dst[256] = { 0 };
     int pos = 0;
     char c;
 
@@ -1184,53 +1749,56 @@ user_input(struct field *field)
     }
 
     buffer[pos] = '\0';
+    return field_command(field, buffer, false);
+}
+
+bool
+field_command(struct field *field, char *cmd, bool quiet)
+{
+    char move_src[256] = { 0 };
+    char move_dst[256] = { 0 };
 
-    _str_to_lower(buffer);
+    _str_to_lower(cmd);
 
-    if (strcmp(buffer, "deal") == 0) {
-        deal_card(field);
-        printf("Deal card!\n");
+    if (strcmp(cmd, "deal") == 0) {
+        if (!deal_card(field)) {
+            fprintf(stderr, "No cards left to deal!\n");
+            return false;
+        }
+        if (!quiet)
+            printf("Deal card!\n");
         return true;
     }
 
-    if (strcmp(buffer, "undo") == 0) {
+    if (strcmp(cmd, "undo") == 0) {
+        if (field->history.cnt == 0) {
+            fprintf(stderr, "No moves left to undo!\n");
+            return false;
+        }
         undo_move(field);
-        printf("Undo!\n");
+        if (!quiet)
+            printf("Undo!\n");
         return true;
     }
 
-    char *p = buffer;
-    while (*p != ' ')
-        p++;
-    p++;
-    strcpy(move_src, buffer);
-    strcpy(move_dst, p);
-    p = move_src;
-    while (*p != ' ')
-        p++;
+    char *p = strchr(cmd, ' ');
+    if (p == NULL || p == cmd || p[1] == '\0'
+        || strlen(cmd) >= sizeof(move_src)) {
+        fprintf(stderr, "Not a valid command: %s\n", cmd);
+        return false;
+    }
     *p = '\0';
+    strcpy(move_src, cmd);
+    strcpy(move_dst, p + 1);
+    *p = ' ';
 
-    enum card_rank rank = RANK_MAX;
-    enum card_suit suit = SUIT_MAX;
+    enum card_rank rank;
+    enum card_suit suit;
     struct card *src_card = NULL;
     struct pile *dst_pile = NULL;
 
-    int i;
-    char n = _str_last_char(move_src);
-
-    for (i = 0; i < RANK_MAX; ++i)
-        if (move_src[0] == rankstr[i][0])
-            rank = i;
-    for (i = 0; i < SUIT_MAX; ++i)
-        if (n == suitstr[i][0])
-            suit = i;
-
-    if (rank == RANK_MAX) {
-        fprintf(stderr, "Not a valid number input: %s %d\n", move_src, rank);
-        return false;
-    }
-    if (suit == SUIT_MAX) {
-        fprintf(stderr, "Not a valid suit input %s %d\n", move_src, suit);
+    if (!card_parse(move_src, &suit, &rank)) {
+        fprintf(stderr, "Not a valid card: %s\n", move_src);
         return false;
     }
 
@@ -1247,7 +1815,7 @@ user_input(struct field *field)
         return false;
     }
 
-    n = _str_last_char(move_dst);
+    char n = _str_last_char(move_dst);
     if (move_dst[0] == 't') {
         switch (n) {
             case '1':
@@ -1306,13 +1874,27 @@ user_input(struct field *field)
         return false;
     }
 
-    printf("Moved from %s to %s\n", move_src, move_dst);
+    if (!quiet)
+        printf("Moved from %s to %s\n", move_src, move_dst);
+
+    enum move_status status = field_play(field, src_card, dst_pile);
+    if (status != MOVE_OK) {
+        fprintf(stderr, "Invalid move: %s\n", move_status_str(status));
+        return false;
+    }
+    return true;
+}
 
-    struct pile *flip_pile = src_card->pile;
-    bool ret = move_card_to_pile(src_card, dst_pile);
-    if (ret)
-        _history_push(field, src_card, flip_pile, dst_pile);
-    pile_top_flip_up(flip_pile);
-    return ret;
+enum move_status
+field_play(struct field *field, struct card *card, struct pile *dst_pile)
+{
+    struct pile *flip_pile = card->pile;
+    enum move_status status = move_card_to_pile_quiet(card, dst_pile);
+    if (status != MOVE_OK)
+        return status;
+    bool flipped = _pile_flip_top(flip_pile);
+    _history_push(field, flip_pile, dst_pile,
+        dst_pile->len - card->pos, flipped, false);
+    return MOVE_OK;
 }
 
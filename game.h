@@ -2,9 +2,13 @@
 #define SOLITAIRE_GAME_H_
 
 #include "card_type.h"
+#include <stddef.h>
 #include <stdint.h>
 
 
+void
+die(char *msg);
+
 // PILE_FUNCTIONS
 /**
  * pile_top_card - Get the top card in a pile.
@@ -43,16 +47,86 @@ pile_has_card(struct pile *pile, struct card *card);
 void
 pile_top_flip_up(struct pile *pile);
 
+void
+card_flip(struct card *card);
+
+struct card *
+card_next(struct card *card);
+
+struct card *
+card_prev(struct card *card);
+
 bool
 card_is_top_of_pile(struct card *card);
 
+/**
+ * card_str - Write a card the way moves name it, as in "as" or "xh".
+ * @card: struct card * to write, or NULL for "--"
+ * @buf: char * with room for 3 bytes
+ *
+ * Returns 2, the length written before the terminating NUL.
+ */
+size_t
+card_str(struct card const *card, char *buf);
+
+/**
+ * card_parse - Read a card written as card_str writes it.
+ * @str: char const * holding a rank letter and a suit letter and no more
+ * @suit: enum card_suit * to store the suit in
+ * @rank: enum card_rank * to store the rank in
+ *
+ * Returns false, leaving suit and rank alone, if str is not a card.
+ */
+bool
+card_parse(char const *str, enum card_suit *suit, enum card_rank *rank);
+
 // DECK FUNCTIONS
 void
 deck_init(struct deck *deck);
 
+/**
+ * deck_init_seeded - Set up the deck of a numbered deal.
+ * @deck: struct deck * to set up
+ * @seed: uint64_t deal number
+ *
+ * The deal number seeds a xoshiro256** generator through splitmix64, which
+ * drives a Fisher-Yates shuffle of the standard deck (see deal_permute), so a
+ * deal number names the same deal on every thread and platform. The number is
+ * kept in deck->seed. Keeps no global state, so decks can be dealt from many
+ * threads at once. deck_init picks a deal number from the clock and does the
+ * same.
+ */
+void
+deck_init_seeded(struct deck *deck, uint64_t seed);
+
+/**
+ * deck_init_arena - Set up the deck of a numbered deal in an arena.
+ * @deck: struct deck * to set up
+ * @seed: uint64_t deal number
+ * @arena: struct arena * to take the cards from, or NULL for the heap
+ *
+ * Same as deck_init_seeded. deck_destroy leaves arena memory alone, it goes
+ * back with arena_reset.
+ */
+void
+deck_init_arena(struct deck *deck, uint64_t seed, struct arena *arena);
+
 void
 deck_destroy(struct deck *deck);
 
+/**
+ * deck_search - Find a card by suit and rank in O(1).
+ * @deck: struct deck * set up by deck_init
+ * @suit: enum card_suit of the card
+ * @rank: enum card_rank of the card
+ *
+ * Returns the card, or NULL if suit or rank is out of range. The pile and
+ * face of a stock or waste card may be out of date after a recycle, use
+ * field_search to find where a card is.
+ */
+struct card *
+deck_search(struct deck *deck, enum card_suit suit, enum card_rank rank);
+
 struct card *
 field_search(
     struct field *field,
@@ -70,24 +144,240 @@ move_card_to_pile(struct card *src_card, struct pile *dst_pile);
 bool
 move_card_to_card(struct card *src, struct card *dst);
 
+/**
+ * move_card_to_pile_quiet - Move a card, and any cards on top of it, to a pile.
+ * @src_card: struct card * to move
+ * @dst_pile: struct pile * to move the card to
+ *
+ * Same as move_card_to_pile but does no I/O. Returns MOVE_OK if the card was
+ * moved, or the reason it was not. Nothing is moved on failure.
+ */
+enum move_status
+move_card_to_pile_quiet(struct card *src_card, struct pile *dst_pile);
+
+/**
+ * move_card_to_card_quiet - Move a card, and any cards on top of it, onto a
+ * card.
+ * @src_card: struct card * to move
+ * @dst_card: struct card * to move the card onto
+ *
+ * Same as move_card_to_card but does no I/O. Returns MOVE_OK if the card was
+ * moved, or the reason it was not. Nothing is moved on failure.
+ */
+enum move_status
+move_card_to_card_quiet(struct card *src_card, struct card *dst_card);
+
+/**
+ * move_status_str - Get a message describing a move status, for the UI.
+ * @status: enum move_status to describe
+ */
+char const *
+move_status_str(enum move_status status);
+
+/**
+ * field_gen_moves - List every legal move of a position.
+ * @field: struct field * to generate moves for
+ * @moves: struct card_move * buffer to write the moves into
+ * @max: number of moves the buffer can hold
+ *
+ * Covers waste to tableau and foundation, tableau to tableau including stacks,
+ * tableau to foundation, foundation to tableau, and the deal or recycle. Does
+ * no I/O and no allocation. Returns the number of legal moves, of which only
+ * the first max are written. A buffer of FIELD_MAX_MOVES is always enough.
+ */
+int
+field_gen_moves(struct field *field, struct card_move *moves, int max);
+
+/**
+ * field_apply_move - Play a move and record it in the history.
+ * @field: struct field * to play the move on
+ * @move: struct card_move * to play, typically from field_gen_moves
+ *
+ * Flips the card uncovered by the move face up, as user_input does. Returns
+ * false without changing the field if the move is not legal.
+ */
+bool
+field_apply_move(struct field *field, struct card_move *move);
+
+/**
+ * field_play - Move a card, and any cards on top of it, as the player would.
+ * @field: struct field * holding the card
+ * @card: struct card * to move, as found by field_search
+ * @dst_pile: struct pile * to move it onto
+ *
+ * Same as move_card_to_pile_quiet, but also flips the card uncovered by the
+ * move face up and records the move for undo_move. Returns MOVE_OK or the
+ * reason the card was not moved, in which case nothing changed.
+ */
+enum move_status
+field_play(struct field *field, struct card *card, struct pile *dst_pile);
+
 
 
 // FIELD FUNCTIONS
 void
 field_snapshot_init(struct field *field);
 
+/**
+ * field_pile - Get a pile of the field by its location.
+ * @field: struct field * holding the pile
+ * @location: any location from LOC_STOCK to LOC_FOUND3
+ *
+ * Returns the pile or NULL if location does not name a pile of the field.
+ */
+struct pile *
+field_pile(struct field *field, enum card_location location);
+
+/**
+ * field_hash - Get the Zobrist key of the current position.
+ * @field: struct field * to get the key of
+ *
+ * The key is kept up to date by every move, deal and undo, so this is O(1).
+ * It covers which pile every card is in and whether it is face up. Within one
+ * deal that fully determines the position, since face down tableau cards never
+ * move and the stock and waste always keep the same cyclic order.
+ */
+uint64_t
+field_hash(struct field *field);
+
+/**
+ * field_hash_compute - Recompute the Zobrist key of a field from scratch.
+ * @field: struct field * to hash
+ *
+ * Returns the value field_hash should hold. Meant for checking the
+ * incremental key, not for use in hot paths.
+ */
+uint64_t
+field_hash_compute(struct field *field);
+
+/**
+ * field_pack - Encode the position of a field into a struct field_pack.
+ * @field: struct field * to encode
+ * @pack: struct field_pack * to write the position into
+ *
+ * The encoding does not depend on the deck or on any pointers, so the same
+ * position always produces the same bytes.
+ */
+void
+field_pack(struct field *field, struct field_pack *pack);
+
+/**
+ * field_unpack - Build a field from a packed position.
+ * @field: uninitialized struct field * to build, as with field_init
+ * @deck: struct deck * with a full set of cards, as set up by deck_init
+ * @pack: struct field_pack * holding the position
+ *
+ * The field starts with an empty history. Returns false and leaves the field
+ * uninitialized if the pack does not hold every card exactly once, a pile
+ * would overflow or a stock card is face up or a waste card face down.
+ */
+bool
+field_unpack(struct field *field, struct deck *deck, struct field_pack *pack);
+
 void
 field_init(struct field *field, struct deck *deck);
 
+/**
+ * field_init_arena - Deal a deck out onto a new field, in an arena.
+ * @field: struct field * to set up
+ * @deck: struct deck * to deal
+ * @arena: struct arena * to take the history from, or NULL for the heap
+ *
+ * Same as field_init. The history still doubles when it runs out of room, and
+ * the outgrown blocks stay in the arena until it is reset.
+ */
+void
+field_init_arena(struct field *field, struct deck *deck, struct arena *arena);
+
+/**
+ * field_reset - Deal a new game into the storage of a field.
+ * @field: struct field * set up by field_init, along with its deck
+ * @seed: uint64_t deal number of the new game
+ *
+ * The same as destroying the field and its deck and setting them up again
+ * with deck_init_seeded and field_init, but the card array and the history are
+ * kept. Once the history has grown to fit the longest game, playing game after
+ * game this way does not touch the heap.
+ */
+void
+field_reset(struct field *field, uint64_t seed);
+
 void
 field_destroy(struct field *field);
 
 void
 field_snapshot(struct field *field);
 
+/**
+ * undo_move - Take back the last move, deal or recycle of the history.
+ * @field: struct field * to undo on
+ *
+ * The history records how many cards moved and whether a card was turned face
+ * up, so undoing puts the field back exactly as it was, in time linear in the
+ * cards moved. A recycle and its undo only reverse the index bytes of the
+ * waste or the stock.
+ */
 void
 undo_move(struct field *field);
 
+/**
+ * field_history_copy - Copy the history of one field into another.
+ * @dst: struct field * to copy into, its own history is dropped
+ * @src: struct field * to copy from
+ *
+ * The history names piles rather than cards, so once dst holds the same
+ * position as src, for example through field_pack and field_unpack, dst can
+ * undo its way back to the start of src's game.
+ */
+void
+field_history_copy(struct field *dst, struct field *src);
+
+/**
+ * field_freeze - Copy a game into a struct field_frozen.
+ * @field: struct field * to copy, left as it is
+ * @frozen: struct field_frozen * to fill in
+ *
+ * The field and its deck can then be destroyed until field_thaw brings the
+ * game back. The history is copied into a block of its own exact size.
+ */
+void
+field_freeze(struct field *field, struct field_frozen *frozen);
+
+/**
+ * field_thaw - Set up a deck and a field to play on from a frozen game.
+ * @field: uninitialized struct field * to build, as with field_init
+ * @deck: uninitialized struct deck * to build, as with deck_init_seeded
+ * @frozen: struct field_frozen * from field_freeze, emptied on success
+ *
+ * The field holds the same position and can undo the same moves as the field
+ * that was frozen. Returns false and leaves the deck and field uninitialized
+ * if the frozen position does not unpack.
+ */
+bool
+field_thaw(struct field *field, struct deck *deck, struct field_frozen *frozen);
+
+void
+field_frozen_destroy(struct field_frozen *frozen);
+
+
+bool
+game_completion_check(struct field *field);
+
+/**
+ * dead_end_check - Check whether no card can usefully move any more.
+ * @field: struct field * to check
+ *
+ * A move is useful when it takes the last face up card of a tableau, turning
+ * the card under it, or a stock or waste card, to a tableau or a foundation,
+ * or the top card of a tableau to a foundation.
+ * Whether each pile has a card for each other pile is kept in the field, and
+ * only the piles changed since the last call are looked at again, so checking
+ * after every move costs time linear in the piles the move touched.
+ *
+ * Unlike game_over, prints nothing.
+ */
+bool
+dead_end_check(struct field *field);
 
 bool
 game_over(struct field *field);
@@ -95,5 +385,18 @@ game_over(struct field *field);
 bool
 user_input(struct field *field);
 
+/**
+ * field_command - Play one command in the notation user_input reads.
+ * @field: struct field * to play on
+ * @cmd: char * command, lowercased in place: "deal", "undo" or a card and a
+ *       destination such as "as f1"
+ * @quiet: bool, true to print nothing when the command is played
+ *
+ * Returns true if the command was played. Otherwise the field is unchanged
+ * and the reason is printed, even when quiet.
+ */
+bool
+field_command(struct field *field, char *cmd, bool quiet);
+
 
 #endif // SOLITAIRE_GAME_H_
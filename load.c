@@ -0,0 +1,455 @@
+#include "load.h"
+#include "game.h"
+#include "server.h"
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+struct load_conn {
+    int fd;
+    struct deck deck;
+    struct field field;
+    bool ready;                 // The deck and field are set up
+    bool dealt;                 // A game is being played
+    struct rng rng;
+    uint64_t deal;              // Deal number of the next new game
+    int moves;                  // Moves played in this game
+    enum load_cmd cmd;          // Request in flight
+    struct card_move move;      // Move in flight, to play on the copy
+    uint64_t sent;              // When the request went out
+    size_t in_len;
+    char in[SERVER_LINE_MAX];
+};
+
+struct load_worker {
+    pthread_t thread;
+    struct load_opts *opts;
+    struct load_conn *conns;
+    int cnt;
+    int err;
+    uint64_t deadline;
+    struct load_stats stats;
+};
+
+static inline uint64_t
+_now_ns(void);
+
+static inline int
+_hist_bucket(uint64_t ns);
+
+static inline uint64_t
+_hist_bucket_top(int bucket);
+
+static inline int
+_move_cmd(struct field *field, struct card_move *move, char *buf, size_t len);
+
+static int
+_conn_open(char const *path);
+
+static inline int
+_conn_send(struct load_worker *worker, struct load_conn *conn);
+
+static inline bool
+_conn_answer(struct load_worker *worker, struct load_conn *conn, char *line);
+
+static void *
+_load_worker(void *arg);
+
+// INTERNAL IMPLEMENTATION
+
+static inline uint64_t
+_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Values below 16 get a bucket each, above that the top five bits pick one
+static inline int
+_hist_bucket(uint64_t ns)
+{
+    if (ns < (1U << LOAD_HIST_SUB_BITS))
+        return (int)ns;
+    int e = 63 - __builtin_clzll(ns);
+    int group = e - LOAD_HIST_SUB_BITS + 1;
+    int sub = (int)(ns >> (e - LOAD_HIST_SUB_BITS))
+        & ((1 << LOAD_HIST_SUB_BITS) - 1);
+    return (group << LOAD_HIST_SUB_BITS) + sub;
+}
+
+static inline uint64_t
+_hist_bucket_top(int bucket)
+{
+    int group = bucket >> LOAD_HIST_SUB_BITS;
+    uint64_t sub = (uint64_t)(bucket & ((1 << LOAD_HIST_SUB_BITS) - 1));
+    if (group == 0)
+        return sub;
+    int shift = group - 1;
+    uint64_t low = ((1ULL << LOAD_HIST_SUB_BITS) + sub) << shift;
+    return low + ((1ULL << shift) - 1);
+}
+
+// Writes a move in the notation of the server
+static inline int
+_move_cmd(struct field *field, struct card_move *move, char *buf, size_t len)
+{
+    char name[3];
+
+    if (move->src == LOC_STOCK || move->dst == LOC_STOCK)
+        return snprintf(buf, len, "deal\n");
+
+    struct pile *src = field_pile(field, move->src);
+    card_str(pile_get_nth_card(src, move->cnt - 1), name);
+    if (move->dst >= LOC_FOUND0)
+        return snprintf(buf, len, "%s f%d\n", name,
+            move->dst - LOC_FOUND0 + 1);
+    return snprintf(buf, len, "%s t%d\n", name, move->dst - LOC_TAB0 + 1);
+}
+
+static int
+_conn_open(char const *path)
+{
+    struct sockaddr_un addr = { 0 };
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    return fd;
+}
+
+// Picks the next request and sends it. Requests are a few bytes and only one
+// is ever in flight, so the send never waits on the server. Returns 0 or an
+// errno value.
+static inline int
+_conn_send(struct load_worker *worker, struct load_conn *conn)
+{
+    struct load_opts *opts = worker->opts;
+    struct field *field = &conn->field;
+    struct card_move moves[FIELD_MAX_MOVES];
+    char buf[SERVER_LINE_MAX];
+    int len = 0;
+
+    if (conn->dealt && conn->moves >= opts->max_moves) {
+        worker->stats.games++;
+        conn->dealt = false;
+    }
+
+    if (!conn->dealt) {
+        conn->cmd = LOAD_NEW;
+        len = snprintf(buf, sizeof(buf), "new %llu\n",
+            (unsigned long long)conn->deal);
+    } else if (field->history.cnt > 0 && opts->undo_rate > 0
+        && (double)(rng_next(&conn->rng) >> 11) * 0x1p-53 < opts->undo_rate) {
+        conn->cmd = LOAD_UNDO;
+        len = snprintf(buf, sizeof(buf), "undo\n");
+    } else {
+        int cnt = field_gen_moves(field, moves, FIELD_MAX_MOVES);
+        if (cnt == 0) {
+            // Stuck without the server calling it a dead end
+            worker->stats.games++;
+            conn->dealt = false;
+            return _conn_send(worker, conn);
+        }
+        if (cnt > FIELD_MAX_MOVES)
+            cnt = FIELD_MAX_MOVES;
+        sim_policy_fn policy = sim_policy_get(opts->policy);
+        conn->move = moves[policy(field, moves, cnt, &conn->rng)];
+        conn->cmd = conn->move.src == LOC_STOCK || conn->move.dst == LOC_STOCK
+            ? LOAD_DEAL : LOAD_MOVE;
+        len = _move_cmd(field, &conn->move, buf, sizeof(buf));
+    }
+
+    conn->sent = _now_ns();
+    if (send(conn->fd, buf, (size_t)len, MSG_NOSIGNAL) != len)
+        return errno ? errno : EIO;
+    return 0;
+}
+
+// Plays an answer on the copy of the game. Returns true if the answer is the
+// one the copy expected.
+static inline bool
+_conn_answer(struct load_worker *worker, struct load_conn *conn, char *line)
+{
+    struct load_stats *stats = &worker->stats;
+    struct field *field = &conn->field;
+    load_hist_add(&stats->hists[conn->cmd], _now_ns() - conn->sent);
+
+    if (strncmp(line, "ok", 2) != 0) {
+        stats->errors++;
+        stats->games++;
+        conn->dealt = false;
+        return false;
+    }
+
+    switch (conn->cmd) {
+        case LOAD_NEW:
+            if (!conn->ready) {
+                deck_init_seeded(&conn->deck, conn->deal);
+                field_init(field, &conn->deck);
+                conn->ready = true;
+            } else {
+                field_reset(field, conn->deal);
+            }
+            rng_seed(&conn->rng, ~conn->deal);
+            conn->deal += (uint64_t)worker->opts->connections;
+            conn->moves = 0;
+            conn->dealt = true;
+            return true;
+        case LOAD_DEAL:
+        case LOAD_MOVE:
+            field_apply_move(field, &conn->move);
+            conn->moves++;
+            break;
+        case LOAD_UNDO:
+            undo_move(field);
+            conn->moves++;
+            break;
+        default:
+            assert(false);
+    }
+
+    if (strcmp(line, "ok won") == 0) {
+        stats->won++;
+        stats->games++;
+        conn->dealt = false;
+    } else if (strcmp(line, "ok dead") == 0) {
+        stats->games++;
+        conn->dealt = false;
+    } else if (game_completion_check(field)) {
+        // The copy won but the server did not say so
+        stats->errors++;
+        stats->games++;
+        conn->dealt = false;
+    }
+    return true;
+}
+
+static void *
+_load_worker(void *arg)
+{
+    struct load_worker *worker = arg;
+    struct epoll_event events[64];
+    int live = 0;
+    int i;
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) {
+        worker->err = errno;
+        return NULL;
+    }
+    for (i = 0; i < worker->cnt; ++i) {
+        struct load_conn *conn = &worker->conns[i];
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = conn };
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, conn->fd, &ev) < 0
+            || (worker->err = _conn_send(worker, conn)) != 0) {
+            worker->err = worker->err ? worker->err : errno;
+            close(epfd);
+            return NULL;
+        }
+        live++;
+    }
+
+    while (live > 0) {
+        int n = epoll_wait(epfd, events, 64, -1);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            worker->err = errno;
+            break;
+        }
+        for (i = 0; i < n; ++i) {
+            struct load_conn *conn = events[i].data.ptr;
+            ssize_t got = recv(conn->fd, conn->in + conn->in_len,
+                sizeof(conn->in) - conn->in_len, MSG_DONTWAIT);
+            if (got <= 0) {
+                if (got < 0 && (errno == EAGAIN || errno == EINTR))
+                    continue;
+                worker->err = got == 0 ? ECONNRESET : errno;
+                epoll_ctl(epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+                live--;
+                continue;
+            }
+            conn->in_len += (size_t)got;
+            char *nl = memchr(conn->in, '\n', conn->in_len);
+            if (nl == NULL)
+                continue;
+
+            // Only one request is ever in flight, so this is the whole answer
+            *nl = '\0';
+            _conn_answer(worker, conn, conn->in);
+            conn->in_len = 0;
+
+            int err = 0;
+            if (_now_ns() >= worker->deadline
+                || (err = _conn_send(worker, conn)) != 0) {
+                if (err != 0)
+                    worker->err = err;
+                epoll_ctl(epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+                live--;
+            }
+        }
+    }
+    close(epfd);
+    return NULL;
+}
+
+// EXTERNAL / PUBLIC FUNCTIONS
+
+void
+load_opts_default(struct load_opts *opts)
+{
+    memset(opts, 0, sizeof(struct load_opts));
+    opts->connections = 64;
+    opts->threads = 1;
+    opts->seconds = 5;
+    opts->policy = SIM_GREEDY;
+    opts->undo_rate = 0.02;
+    opts->max_moves = 500;
+}
+
+int
+load_run(struct load_opts *opts, struct load_stats *stats)
+{
+    if (opts->threads < 1)
+        opts->threads = 1;
+    if (opts->connections < opts->threads)
+        opts->connections = opts->threads;
+
+    int threads = opts->threads;
+    int cnt = opts->connections;
+    struct load_worker *workers = calloc((size_t)threads, sizeof(*workers));
+    struct load_conn *conns = calloc((size_t)cnt, sizeof(*conns));
+    if (workers == NULL || conns == NULL)
+        die("calloc");
+
+    int err = 0;
+    int opened;
+    for (opened = 0; opened < cnt; ++opened) {
+        conns[opened].fd = _conn_open(opts->path);
+        if (conns[opened].fd < 0) {
+            err = errno;
+            break;
+        }
+        conns[opened].deal = opts->first + (uint64_t)opened;
+    }
+
+    uint64_t start = _now_ns();
+    uint64_t deadline = start + (uint64_t)(opts->seconds * 1e9);
+    int started = 0;
+    int i;
+    if (err == 0) {
+        for (i = 0; i < threads; ++i) {
+            struct load_worker *worker = &workers[i];
+            int lo = cnt * i / threads;
+            worker->opts = opts;
+            worker->conns = conns + lo;
+            worker->cnt = cnt * (i + 1) / threads - lo;
+            worker->deadline = deadline;
+        }
+        for (started = 0; started < threads; ++started) {
+            err = pthread_create(&workers[started].thread, NULL,
+                _load_worker, &workers[started]);
+            if (err != 0)
+                break;
+        }
+    }
+
+    memset(stats, 0, sizeof(struct load_stats));
+    for (i = 0; i < started; ++i) {
+        struct load_worker *worker = &workers[i];
+        pthread_join(worker->thread, NULL);
+        int j;
+        for (j = 0; j < LOAD_CMD_MAX; ++j)
+            load_hist_merge(&stats->hists[j], &worker->stats.hists[j]);
+        stats->games += worker->stats.games;
+        stats->won += worker->stats.won;
+        stats->errors += worker->stats.errors;
+        if (err == 0)
+            err = worker->err;
+    }
+    stats->seconds = (double)(_now_ns() - start) * 1e-9;
+
+    for (i = 0; i < opened; ++i) {
+        close(conns[i].fd);
+        if (conns[i].ready) {
+            field_destroy(&conns[i].field);
+            deck_destroy(&conns[i].deck);
+        }
+    }
+    free(conns);
+    free(workers);
+    return err;
+}
+
+void
+load_hist_add(struct load_hist *hist, uint64_t ns)
+{
+    hist->counts[_hist_bucket(ns)]++;
+    hist->cnt++;
+    if (ns > hist->max)
+        hist->max = ns;
+}
+
+void
+load_hist_merge(struct load_hist *dst, struct load_hist *src)
+{
+    int i;
+    for (i = 0; i < LOAD_HIST_BUCKETS; ++i)
+        dst->counts[i] += src->counts[i];
+    dst->cnt += src->cnt;
+    if (src->max > dst->max)
+        dst->max = src->max;
+}
+
+uint64_t
+load_hist_percentile(struct load_hist *hist, double p)
+{
+    if (hist->cnt == 0)
+        return 0;
+    // The rank of the percentile, counted from 1
+    uint64_t rank = (uint64_t)(p / 100.0 * (double)hist->cnt + 0.5);
+    if (rank < 1)
+        rank = 1;
+    if (rank > hist->cnt)
+        rank = hist->cnt;
+
+    uint64_t seen = 0;
+    int i;
+    for (i = 0; i < LOAD_HIST_BUCKETS; ++i) {
+        seen += hist->counts[i];
+        if (seen >= rank)
+            break;
+    }
+    uint64_t top = _hist_bucket_top(i);
+    return top < hist->max ? top : hist->max;
+}
+
+char const *
+load_cmd_str(enum load_cmd cmd)
+{
+    char const *strs[] = { "new", "deal", "undo", "move" };
+    if (cmd < LOAD_NEW || cmd >= LOAD_CMD_MAX)
+        return "invalid";
+    return strs[cmd];
+}
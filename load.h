@@ -0,0 +1,95 @@
+#ifndef SOLITAIRE_LOAD_H_
+#define SOLITAIRE_LOAD_H_
+
+#include "sim.h"
+#include <stdint.h>
+
+// Latencies in nanoseconds, 16 buckets to every power of two, so a bucket is
+// never more than 1/16 wider than the values in it
+#define LOAD_HIST_SUB_BITS 4
+#define LOAD_HIST_BUCKETS ((64 - LOAD_HIST_SUB_BITS + 1) << LOAD_HIST_SUB_BITS)
+
+enum load_cmd {
+    LOAD_NEW,
+    LOAD_DEAL,
+    LOAD_UNDO,
+    LOAD_MOVE,
+    LOAD_CMD_MAX,
+};
+
+struct load_hist {
+    uint64_t counts[LOAD_HIST_BUCKETS];
+    uint64_t cnt;
+    uint64_t max;
+};
+
+struct load_opts {
+    char const *path;           // Socket of a klondike --serve
+    int connections;            // Games played at once
+    int threads;                // Threads sharing the connections
+    double seconds;             // How long to keep sending
+    uint64_t first;             // Deal number of the first game
+    enum sim_policy policy;     // How moves are picked
+    double undo_rate;           // Odds that a turn is an undo
+    int max_moves;              // Moves before a game is given up
+};
+
+struct load_stats {
+    struct load_hist hists[LOAD_CMD_MAX];
+    uint64_t games;
+    uint64_t won;
+    uint64_t errors;            // Answers the local copy disagreed with
+    double seconds;
+};
+
+/**
+ * load_opts_default - Fill in the default load options.
+ * @opts: struct load_opts * to fill in
+ */
+void
+load_opts_default(struct load_opts *opts);
+
+/**
+ * load_run - Play games against a server and time every request.
+ * @opts: struct load_opts * describing the load
+ * @stats: struct load_stats * to fill in
+ *
+ * Each connection plays one game after another, dealt as deal numbers first,
+ * first + 1 and so on across the connections. It keeps its own copy of the
+ * game, lets the policy pick a move from field_gen_moves, sends it, and waits
+ * for the answer before sending the next request, as a player would. Answers
+ * that the copy disagrees with count as errors and start a new game. After
+ * the time is up each connection finishes the request it has in flight.
+ *
+ * Returns 0 on success or an errno value if the connections or threads could
+ * not be set up.
+ */
+int
+load_run(struct load_opts *opts, struct load_stats *stats);
+
+void
+load_hist_add(struct load_hist *hist, uint64_t ns);
+
+/**
+ * load_hist_merge - Add the counts of one histogram to another.
+ * @dst: struct load_hist * to add to
+ * @src: struct load_hist * to add
+ */
+void
+load_hist_merge(struct load_hist *dst, struct load_hist *src);
+
+/**
+ * load_hist_percentile - Get a percentile of the latencies in a histogram.
+ * @hist: struct load_hist * to look in
+ * @p: double percentile, in [0, 100]
+ *
+ * Returns the upper end of the bucket holding the percentile, in nanoseconds,
+ * or 0 for an empty histogram.
+ */
+uint64_t
+load_hist_percentile(struct load_hist *hist, double p);
+
+char const *
+load_cmd_str(enum load_cmd cmd);
+
+#endif // SOLITAIRE_LOAD_H_
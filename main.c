@@ -2,9 +2,18 @@
 #include "game.h"
 // #include "test.h"
 #include "debug.h"
+#include "solver.h"
+#include "batch.h"
+#include "sim.h"
+#include "render.h"
+#include "server.h"
+#include "load.h"
 #include <assert.h>
 #include <ctype.h>
 #include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
 #include <stdint.h>
 #include <string.h>
 #include <stdbool.h>
@@ -33,28 +42,471 @@ set_raw_mode(void)
     tcsetattr(STDIN_FILENO, TCSANOW, &new_term);
 }
 
+static void
+usage(char const *prog)
+{
+    printf("Usage: %s [options]\n", prog);
+    printf("\n");
+    printf("With no options, play an interactive game.\n");
+    printf("\n");
+    printf("  -d, --deal N       Play or solve deal N instead of a new one\n");
+    printf("  -s, --solve        Solve a new deal and print the moves\n");
+    printf("  -t, --thoughtful   Let the solver see face down cards\n");
+    printf("  -n, --nodes N      Give up solving after N moves tried\n");
+    printf("  -T, --time S       Give up solving after S seconds\n");
+    printf("  -b, --batch A-B    Solve deals A to B and print one line per\n");
+    printf("                     deal: seed, result, nodes, seconds\n");
+    printf("  -j, --threads N    Number of threads for --batch\n");
+    printf("  -m, --simulate N   Play N games from --deal or deal 0 and\n");
+    printf("                     print the win rate\n");
+    printf("  -p, --policy P     How --simulate plays: random, greedy or\n");
+    printf("                     foundation-first (default greedy)\n");
+    printf("  -S, --script       Play moves from standard input, one per\n");
+    printf("                     line or split by ';', and print the board\n");
+    printf("                     they end on\n");
+    printf("  -l, --serve PATH   Serve games over the Unix socket at PATH,\n");
+    printf("                     one line per request, until stopped\n");
+    printf("  -c, --max-sessions N\n");
+    printf("                     Connections --serve takes at once\n");
+    printf("  -i, --idle S       Seconds before an idle --serve game is\n");
+    printf("                     packed away, 0 for never, else at least\n");
+    printf("                     0.001 (default 30)\n");
+    printf("  -L, --load PATH    Play games against a --serve at PATH and\n");
+    printf("                     print the requests per second and the\n");
+    printf("                     latency of each kind of request\n");
+    printf("  -C, --connections N\n");
+    printf("                     Games --load plays at once over --threads\n");
+    printf("  -D, --duration S   Seconds --load runs for\n");
+    printf("  -u, --undo-rate R  Odds that a --load turn is an undo\n");
+    printf("  -h, --help         Show this message\n");
+}
+
+static void
+deal(struct deck *deck, bool numbered, uint64_t number)
+{
+    if (numbered)
+        deck_init_seeded(deck, number);
+    else
+        deck_init(deck);
+}
+
+// Sends the cells that changed since the last redraw
+static void
+redraw(struct render_screen *screen, struct field *field)
+{
+    // Anything printf still holds goes out first
+    fflush(stdout);
+    if (render_screen_diff(screen, field) > 0
+        && render_flush(&screen->out, STDOUT_FILENO) < 0)
+        perror("write");
+}
+
+static int
+solve(struct solver_opts *opts, bool numbered, uint64_t number)
+{
+    struct deck deck = { 0 };
+    struct field field = { 0 };
+    struct solver solver;
+
+    deal(&deck, numbered, number);
+    printf("Deal: %llu\n", (unsigned long long)deck.seed);
+    field_init(&field, &deck);
+    field_sym_print(&field);
+
+    solver_init(&solver, opts);
+    enum solve_result result = solver_run(&solver, &field);
+
+    printf("Result: %s, nodes: %llu, time: %.3fs\n",
+        solve_result_str(result),
+        (unsigned long long)solver.nodes,
+        solver.seconds);
+
+    int i;
+    char buf[16];
+    for (i = 0; i < solver.solution_len; ++i) {
+        solve_step_str(&solver.solution[i], buf, sizeof(buf));
+        printf("%s\n", buf);
+    }
+
+    solver_destroy(&solver);
+    field_destroy(&field);
+    deck_destroy(&deck);
+    return result == SOLVE_WON ? 0 : 1;
+}
+
+static int
+batch(struct batch_opts *opts)
+{
+    uint64_t cnt = opts->last - opts->first + 1;
+    struct batch_result *results = calloc(cnt, sizeof(struct batch_result));
+    if (results == NULL)
+        die("calloc");
+
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int err = batch_run(opts, results);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (err != 0) {
+        errno = err;
+        die("batch_run");
+    }
+
+    uint64_t totals[SOLVE_UNKNOWN + 1] = { 0 };
+    uint64_t i;
+    for (i = 0; i < cnt; ++i) {
+        struct batch_result *res = &results[i];
+        printf("%llu %s %llu %.6f\n",
+            (unsigned long long)res->seed,
+            solve_result_str(res->result),
+            (unsigned long long)res->nodes,
+            res->seconds);
+        totals[res->result]++;
+    }
+
+    double secs = (double)(end.tv_sec - start.tv_sec)
+        + (double)(end.tv_nsec - start.tv_nsec) * 1e-9;
+    fprintf(stderr,
+        "deals: %llu won: %llu lost: %llu unknown: %llu "
+        "threads: %d time: %.3fs deals/s: %.1f\n",
+        (unsigned long long)cnt,
+        (unsigned long long)totals[SOLVE_WON],
+        (unsigned long long)totals[SOLVE_LOST],
+        (unsigned long long)totals[SOLVE_UNKNOWN],
+        opts->threads,
+        secs,
+        (double)cnt / secs);
+
+    free(results);
+    return 0;
+}
+
+// Drops the spaces around a command
+static char *
+trim(char *str)
+{
+    while (isspace((unsigned char)*str))
+        str++;
+    char *end = str + strlen(str);
+    while (end > str && isspace((unsigned char)end[-1]))
+        *--end = '\0';
+    return str;
+}
+
+// Plays commands from standard input without touching the terminal mode, so
+// a long log of moves replays as fast as it can be parsed. Lines may hold
+// several commands split by ';' and a '#' comments out the rest of a line.
+static int
+script(bool numbered, uint64_t number)
+{
+    struct deck deck = { 0 };
+    struct field field = { 0 };
+    char *line = NULL;
+    size_t cap = 0;
+    uint64_t lineno = 0;
+    uint64_t played = 0;
+    uint64_t rejected = 0;
+
+    // Read the moves in large blocks rather than a line at a time
+    setvbuf(stdin, NULL, _IOFBF, 1 << 16);
+
+    deal(&deck, numbered, number);
+    printf("Deal: %llu\n", (unsigned long long)deck.seed);
+    field_init(&field, &deck);
+
+    while (getline(&line, &cap, stdin) != -1) {
+        ++lineno;
+        char *comment = strchr(line, '#');
+        if (comment != NULL)
+            *comment = '\0';
+
+        char *save;
+        char *cmd;
+        for (cmd = strtok_r(line, ";", &save); cmd != NULL;
+            cmd = strtok_r(NULL, ";", &save)) {
+            cmd = trim(cmd);
+            if (*cmd == '\0')
+                continue;
+            if (field_command(&field, cmd, true)) {
+                ++played;
+            } else {
+                fprintf(stderr, "line %llu: %s\n",
+                    (unsigned long long)lineno, cmd);
+                ++rejected;
+            }
+        }
+    }
+    free(line);
+
+    field_sym_print(&field);
+    game_over(&field);
+    printf("played: %llu rejected: %llu\n",
+        (unsigned long long)played,
+        (unsigned long long)rejected);
+
+    deck_destroy(&deck);
+    field_destroy(&field);
+    return rejected > 0 ? 1 : 0;
+}
+
+static int
+simulate(struct sim_opts *opts)
+{
+    struct sim_stats stats;
+    double lo;
+    double hi;
+
+    sim_run(opts, &stats);
+    sim_wilson(stats.won, stats.games, 1.96, &lo, &hi);
+    printf("policy: %s games: %llu won: %llu win rate: %.2f%% "
+        "95%% CI: %.2f%%-%.2f%% moves/game: %.1f time: %.3fs games/s: %.1f\n",
+        sim_policy_str(opts->policy),
+        (unsigned long long)stats.games,
+        (unsigned long long)stats.won,
+        stats.games ? 100.0 * (double)stats.won / (double)stats.games : 0,
+        100.0 * lo,
+        100.0 * hi,
+        stats.games ? (double)stats.moves / (double)stats.games : 0,
+        stats.seconds,
+        (double)stats.games / stats.seconds);
+    return 0;
+}
+
+static int
+load(struct load_opts *opts)
+{
+    struct load_stats stats;
+    int err = load_run(opts, &stats);
+    if (err != 0) {
+        errno = err;
+        die("load_run");
+    }
+
+    uint64_t requests = 0;
+    struct load_hist all = { 0 };
+    int i;
+    for (i = 0; i < LOAD_CMD_MAX; ++i) {
+        requests += stats.hists[i].cnt;
+        load_hist_merge(&all, &stats.hists[i]);
+    }
+    printf("connections: %d threads: %d time: %.3fs requests: %llu "
+        "requests/s: %.1f games: %llu won: %llu errors: %llu\n",
+        opts->connections,
+        opts->threads,
+        stats.seconds,
+        (unsigned long long)requests,
+        (double)requests / stats.seconds,
+        (unsigned long long)stats.games,
+        (unsigned long long)stats.won,
+        (unsigned long long)stats.errors);
+
+    // Latencies in microseconds
+    printf("%-8s %12s %10s %10s %10s %10s\n",
+        "request", "count", "p50", "p99", "p99.9", "max");
+    for (i = 0; i <= LOAD_CMD_MAX; ++i) {
+        struct load_hist *hist = i < LOAD_CMD_MAX ? &stats.hists[i] : &all;
+        printf("%-8s %12llu %10.1f %10.1f %10.1f %10.1f\n",
+            i < LOAD_CMD_MAX ? load_cmd_str(i) : "all",
+            (unsigned long long)hist->cnt,
+            (double)load_hist_percentile(hist, 50) * 1e-3,
+            (double)load_hist_percentile(hist, 99) * 1e-3,
+            (double)load_hist_percentile(hist, 99.9) * 1e-3,
+            (double)hist->max * 1e-3);
+    }
+    return stats.errors > 0 ? 1 : 0;
+}
 
-// TODO: Add help message for -h flag
 int
-main(void)
+main(int argc, char **argv)
 {
+    static struct option const long_opts[] = {
+        { "deal", required_argument, NULL, 'd' },
+        { "solve", no_argument, NULL, 's' },
+        { "thoughtful", no_argument, NULL, 't' },
+        { "nodes", required_argument, NULL, 'n' },
+        { "time", required_argument, NULL, 'T' },
+        { "batch", required_argument, NULL, 'b' },
+        { "threads", required_argument, NULL, 'j' },
+        { "simulate", required_argument, NULL, 'm' },
+        { "policy", required_argument, NULL, 'p' },
+        { "script", no_argument, NULL, 'S' },
+        { "serve", required_argument, NULL, 'l' },
+        { "max-sessions", required_argument, NULL, 'c' },
+        { "idle", required_argument, NULL, 'i' },
+        { "load", required_argument, NULL, 'L' },
+        { "connections", required_argument, NULL, 'C' },
+        { "duration", required_argument, NULL, 'D' },
+        { "undo-rate", required_argument, NULL, 'u' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 },
+    };
+
+    struct solver_opts opts;
+    solver_opts_default(&opts);
+    bool solve_mode = false;
+    bool batch_mode = false;
+    bool sim_mode = false;
+    bool script_mode = false;
+    struct server_opts vopts;
+    server_opts_default(&vopts);
+    struct load_opts lopts;
+    load_opts_default(&lopts);
+    bool threads_set = false;
+    struct sim_opts sopts;
+    sim_opts_default(&sopts);
+    bool numbered = false;
+    uint64_t number = 0;
+    struct batch_opts bopts = { 0 };
+    bopts.threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    int c;
+    char *end;
+    char const *short_opts = "d:stn:T:b:j:m:p:Sl:c:i:L:C:D:u:h";
+    while ((c = getopt_long(argc, argv, short_opts, long_opts, NULL)) != -1) {
+        switch (c) {
+            case 'd':
+                numbered = true;
+                if (sscanf(optarg, "%" SCNu64, &number) != 1) {
+                    fprintf(stderr, "Invalid deal number: %s\n", optarg);
+                    return 2;
+                }
+                break;
+            case 's':
+                solve_mode = true;
+                break;
+            case 't':
+                opts.thoughtful = true;
+                break;
+            case 'n':
+                opts.max_nodes = strtoull(optarg, NULL, 10);
+                break;
+            case 'T':
+                opts.max_seconds = strtod(optarg, NULL);
+                break;
+            case 'b':
+                batch_mode = true;
+                if (sscanf(optarg, "%" SCNu64 "-%" SCNu64,
+                        &bopts.first, &bopts.last) != 2
+                    || bopts.last < bopts.first
+                    // The count of deals would wrap to 0
+                    || bopts.last - bopts.first == UINT64_MAX) {
+                    fprintf(stderr, "Invalid seed range: %s\n", optarg);
+                    return 2;
+                }
+                break;
+            case 'j':
+                bopts.threads = atoi(optarg);
+                threads_set = true;
+                break;
+            case 'm':
+                sim_mode = true;
+                sopts.games = strtoull(optarg, NULL, 10);
+                break;
+            case 'p':
+                sopts.policy = sim_policy_parse(optarg);
+                if (sopts.policy == SIM_POLICY_MAX) {
+                    fprintf(stderr, "Invalid policy: %s\n", optarg);
+                    return 2;
+                }
+                lopts.policy = sopts.policy;
+                break;
+            case 'S':
+                script_mode = true;
+                break;
+            case 'l':
+                vopts.path = optarg;
+                break;
+            case 'c':
+                vopts.max_sessions = atoi(optarg);
+                break;
+            case 'i':
+                vopts.idle_seconds = strtod(optarg, &end);
+                // Sessions are timed in whole milliseconds
+                if (end == optarg || *end != '\0'
+                    || !isfinite(vopts.idle_seconds)
+                    || vopts.idle_seconds < 0
+                    || (vopts.idle_seconds > 0
+                        && vopts.idle_seconds < 0.001)) {
+                    fprintf(stderr, "Invalid idle time: %s\n", optarg);
+                    return 2;
+                }
+                break;
+            case 'L':
+                lopts.path = optarg;
+                break;
+            case 'C':
+                lopts.connections = atoi(optarg);
+                break;
+            case 'D':
+                lopts.seconds = strtod(optarg, NULL);
+                break;
+            case 'u':
+                lopts.undo_rate = strtod(optarg, NULL);
+                break;
+            case 'h':
+                usage(argv[0]);
+                return 0;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+
+    if (vopts.path != NULL) {
+        if (server_run(&vopts) < 0)
+            die("server_run");
+        return 0;
+    }
+
+    if (lopts.path != NULL) {
+        lopts.first = numbered ? number : 0;
+        if (threads_set)
+            lopts.threads = bopts.threads;
+        return load(&lopts);
+    }
+
+    if (batch_mode) {
+        // Hard deals would otherwise hold up the whole batch
+        if (opts.max_nodes == 0 && opts.max_seconds == 0)
+            opts.max_nodes = 1000000;
+        bopts.solver = opts;
+        return batch(&bopts);
+    }
+
+    if (sim_mode) {
+        sopts.first = numbered ? number : 0;
+        return simulate(&sopts);
+    }
+
+    if (solve_mode)
+        return solve(&opts, numbered, number);
+
+    if (script_mode)
+        return script(numbered, number);
 
     set_raw_mode();
     struct deck deck = { 0 };
     struct field field = { 0 };
+    struct render_screen screen;
 
-    deck_init(&deck);
+    deal(&deck, numbered, number);
     field_init(&field, &deck);
 
-    field_sym_print(&field);
+    render_screen_init(&screen);
+    redraw(&screen, &field);
+    // Goes below the board, with everything else printed during the game
+    printf("Deal: %llu\n", (unsigned long long)deck.seed);
 
     while (!game_over(&field)) {
         if (user_input(&field)) {
-            field_sym_print(&field);
+            redraw(&screen, &field);
         }
         // user_input(&field);
     }
 
+    render_screen_end(&screen);
+    render_flush(&screen.out, STDOUT_FILENO);
+
     deck_destroy(&deck);
     field_destroy(&field);
     return 0;
@@ -0,0 +1,340 @@
+#include "render.h"
+#include "game.h"
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define RENDER_GLYPH_MAX 32
+
+// Colored rank and suit of every card by card id, with their lengths
+static char _glyphs[SOLITAIRE_DECK_SIZE][RENDER_GLYPH_MAX];
+static uint8_t _glyph_lens[SOLITAIRE_DECK_SIZE];
+
+static inline void
+_append(struct render *render, char const *str, size_t len);
+
+static inline void
+_append_str(struct render *render, char const *str);
+
+static inline void
+_append_card(struct render *render, struct card *card);
+
+static inline void
+_append_uint(struct render *render, unsigned n);
+
+static inline void
+_append_cup(struct render *render, int line, int col);
+
+static inline void
+_append_cell(struct render *render, uint8_t cell);
+
+static inline void
+_cell_place(int idx, int *line, int *col);
+
+static inline void
+_screen_cells(struct field *field, uint8_t *cells);
+
+// INTERNAL IMPLEMENTATION
+
+__attribute__((constructor)) static void
+_glyphs_init(void)
+{
+    char const *rankstr[] = {
+        "A", "2", "3", "4", "5", "6",
+        "7", "8", "9", "X", "J", "Q", "K"
+    };
+
+    char const *suitstr[] = {
+        "♠", "♦", "♣", "♥",
+    };
+
+    uint32_t const clrstr[] = {
+        0xd72638, 0xd5d5d5
+    };
+
+    int suit;
+    int rank;
+    for (suit = SUIT_SPADE; suit < SUIT_MAX; ++suit) {
+        for (rank = RANK_A; rank < RANK_MAX; ++rank) {
+            int id = suit * RANK_MAX + rank;
+            // Same as the color _deck_generate gives the card
+            uint32_t color = clrstr[!(suit & 0x1)];
+            int len = snprintf(_glyphs[id], RENDER_GLYPH_MAX,
+                "\x1b[38;2;%u;%u;%um%s%s\x1b[0m",
+                (color >> 16) & 0xff, (color >> 8) & 0xff, color & 0xff,
+                rankstr[rank], suitstr[suit]);
+            assert(len > 0 && len < RENDER_GLYPH_MAX);
+            _glyph_lens[id] = (uint8_t)len;
+        }
+    }
+}
+
+static inline void
+_append(struct render *render, char const *str, size_t len)
+{
+    assert(render->len + len <= RENDER_FRAME_MAX);
+    memcpy(render->buf + render->len, str, len);
+    render->len += len;
+}
+
+// For string literals, whose length the compiler knows
+static inline void
+_append_str(struct render *render, char const *str)
+{
+    _append(render, str, strlen(str));
+}
+
+static inline void
+_append_card(struct render *render, struct card *card)
+{
+    int id = card_id(card);
+    _append(render, _glyphs[id], _glyph_lens[id]);
+}
+
+static inline void
+_append_uint(struct render *render, unsigned n)
+{
+    char digits[10];
+    int i = sizeof(digits);
+    do {
+        digits[--i] = (char)('0' + n % 10);
+        n /= 10;
+    } while (n != 0);
+    _append(render, digits + i, sizeof(digits) - (size_t)i);
+}
+
+// Moves the cursor, both counted from 1
+static inline void
+_append_cup(struct render *render, int line, int col)
+{
+    _append_str(render, "\x1b[");
+    _append_uint(render, (unsigned)line);
+    _append_str(render, ";");
+    _append_uint(render, (unsigned)col);
+    _append_str(render, "H");
+}
+
+static inline void
+_append_cell(struct render *render, uint8_t cell)
+{
+    switch (cell) {
+        case RENDER_CELL_BLANK:
+            _append_str(render, "  ");
+            break;
+        case RENDER_CELL_HIDDEN:
+            _append_str(render, "XX");
+            break;
+        case RENDER_CELL_EMPTY:
+            _append_str(render, "EE");
+            break;
+        default:
+            _append(render, _glyphs[cell], _glyph_lens[cell]);
+            break;
+    }
+}
+
+// Where render_frame would put the cell on screen, with the tableau rows
+// pushed down so the bottom row sits on the last tableau line
+static inline void
+_cell_place(int idx, int *line, int *col)
+{
+    // "stock/waste: XX    W    foundations: F1  F2  F3  F4"
+    static int const header_cols[RENDER_HEADER_CELLS] = {
+        14, 20, 39, 43, 47, 51
+    };
+
+    if (idx < RENDER_HEADER_CELLS) {
+        *line = 1;
+        *col = header_cols[idx];
+        return;
+    }
+    idx -= RENDER_HEADER_CELLS;
+    *line = 3 + RENDER_TABLEAU_ROWS - 1 - idx / NUM_TABLEAU;
+    *col = 1 + 4 * (idx % NUM_TABLEAU);
+}
+
+static inline void
+_screen_cells(struct field *field, uint8_t *cells)
+{
+    struct card *card;
+    int i;
+
+    cells[0] = pile_empty(&field->stock)
+        ? RENDER_CELL_EMPTY : RENDER_CELL_HIDDEN;
+    card = pile_top_card(&field->waste);
+    cells[1] = card != NULL ? (uint8_t)card_id(card) : RENDER_CELL_BLANK;
+    for (i = 0; i < NUM_FOUNDATION; ++i) {
+        card = pile_top_card(&field->foundations[i]);
+        cells[2 + i] = card != NULL
+            ? (uint8_t)card_id(card) : RENDER_CELL_HIDDEN;
+    }
+
+    uint8_t *rows = cells + RENDER_HEADER_CELLS;
+    memset(rows, RENDER_CELL_BLANK, RENDER_TABLEAU_ROWS * NUM_TABLEAU);
+    int col;
+    for (col = 0; col < NUM_TABLEAU; ++col) {
+        struct pile *pile = &field->tableaus[col];
+        assert(pile->len <= RENDER_TABLEAU_ROWS);
+        for (i = 0; i < pile->len; ++i) {
+            card = pile_get_nth_card(pile, i);
+            rows[i * NUM_TABLEAU + col] = card->face_up
+                ? (uint8_t)card_id(card) : RENDER_CELL_HIDDEN;
+        }
+    }
+}
+
+// EXTERNAL / PUBLIC FUNCTIONS
+
+size_t
+render_frame(struct render *render, struct field *field)
+{
+    struct card *card;
+    int i;
+
+    render->len = 0;
+    _append_str(render, "stock/waste: ");
+    _append_str(render, pile_empty(&field->stock) ? "EE" : "XX");
+    _append_str(render, "    ");
+    card = pile_top_card(&field->waste);
+    if (card != NULL)
+        _append_card(render, card);
+    else
+        _append_str(render, "  ");
+    _append_str(render, "    foundations: ");
+
+    for (i = 0; i < NUM_FOUNDATION; ++i) {
+        card = pile_top_card(&field->foundations[i]);
+        if (card == NULL)
+            _append_str(render, "XX");
+        else
+            _append_card(render, card);
+        _append_str(render, "  ");
+    }
+    _append_str(render, "\n");
+
+    int height = 0;
+    for (i = 0; i < NUM_TABLEAU; ++i)
+        if (field->tableaus[i].len > height)
+            height = field->tableaus[i].len;
+
+    // Row r shows the r-th card from the top of each tableau, so the tops
+    // line up along the bottom of the board
+    _append_str(render, "tableaus:\n");
+    int row;
+    int col;
+    for (row = height - 1; row >= 0; --row) {
+        for (col = 0; col < NUM_TABLEAU; ++col) {
+            struct pile *pile = &field->tableaus[col];
+            if (row >= pile->len) {
+                _append_str(render, "    ");
+                continue;
+            }
+            card = pile_get_nth_card(pile, row);
+            if (card->face_up)
+                _append_card(render, card);
+            else
+                _append_str(render, "XX");
+            _append_str(render, "  ");
+        }
+        _append_str(render, "\n");
+    }
+    _append_str(render, "\n");
+    return render->len;
+}
+
+int
+render_flush(struct render *render, int fd)
+{
+    size_t done = 0;
+    while (done < render->len) {
+        ssize_t n = write(fd, render->buf + done, render->len - done);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        done += (size_t)n;
+    }
+    return 0;
+}
+
+void
+render_screen_init(struct render_screen *screen)
+{
+    memset(screen->cells, RENDER_CELL_BLANK, sizeof(screen->cells));
+    screen->drawn = false;
+    screen->out.len = 0;
+}
+
+size_t
+render_screen_diff(struct render_screen *screen, struct field *field)
+{
+    struct render *out = &screen->out;
+    uint8_t cells[RENDER_CELLS];
+
+    out->len = 0;
+    _screen_cells(field, cells);
+    if (!screen->drawn) {
+        // Clear the terminal and draw the labels, the cells follow as changes
+        // from a blank board
+        memset(screen->cells, RENDER_CELL_BLANK, sizeof(screen->cells));
+        _append_str(out, "\x1b[H\x1b[2J");
+        _append_str(out, "stock/waste:");
+        _append_cup(out, 1, 26);
+        _append_str(out, "foundations:");
+        _append_cup(out, 2, 1);
+        _append_str(out, "tableaus:");
+    } else {
+        _append_str(out, "\x1b" "7");
+    }
+    size_t start = out->len;
+
+    // Where the cursor is after the last cell drawn. Neighbours on a line are
+    // two columns apart, so stepping over the gap is shorter than moving.
+    int cur_line = 0;
+    int cur_col = 0;
+    int i;
+    for (i = 0; i < RENDER_CELLS; ++i) {
+        if (cells[i] == screen->cells[i])
+            continue;
+        int line;
+        int col;
+        _cell_place(i, &line, &col);
+        if (line == cur_line && col == cur_col + 2)
+            _append_str(out, "  ");
+        else if (line != cur_line || col != cur_col)
+            _append_cup(out, line, col);
+        _append_cell(out, cells[i]);
+        cur_line = line;
+        cur_col = col + 2;
+        screen->cells[i] = cells[i];
+    }
+
+    if (!screen->drawn) {
+        // Keep later output scrolling below the board, which then stays put
+        _append_str(out, "\x1b[");
+        _append_uint(out, RENDER_SCREEN_LINES + 1);
+        _append_str(out, "r");
+        _append_cup(out, RENDER_SCREEN_LINES + 1, 1);
+        screen->drawn = true;
+    } else if (out->len == start) {
+        out->len = 0;
+    } else {
+        _append_str(out, "\x1b" "8");
+    }
+    return out->len;
+}
+
+size_t
+render_screen_end(struct render_screen *screen)
+{
+    struct render *out = &screen->out;
+    out->len = 0;
+    // Out of range lines are clamped to the last one
+    _append_str(out, "\x1b[r\x1b[999;1H\n");
+    screen->drawn = false;
+    return out->len;
+}
@@ -0,0 +1,106 @@
+#ifndef SOLITAIRE_RENDER_H_
+#define SOLITAIRE_RENDER_H_
+
+#include "card_type.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Room for the tallest board: the header and nineteen rows of seven cards,
+// every card a colored glyph
+#define RENDER_FRAME_MAX 8192
+
+/*
+ * A frame of the board, composed into a buffer owned by the caller and sent
+ * to the terminal with one write. The buffer is reused from frame to frame,
+ * so rendering does not touch the heap.
+ */
+struct render {
+    char buf[RENDER_FRAME_MAX];
+    size_t len;
+};
+
+/**
+ * render_frame - Compose the board into a render buffer.
+ * @render: struct render * to compose into, its last frame is dropped
+ * @field: struct field * to draw
+ *
+ * The frame holds the same text field_sym_print shows, ANSI color escapes
+ * included. Returns the length of the frame.
+ */
+size_t
+render_frame(struct render *render, struct field *field);
+
+/**
+ * render_flush - Write the composed frame to a file descriptor.
+ * @render: struct render * holding a frame from render_frame
+ * @fd: file descriptor to write to
+ *
+ * Writes the whole frame in one write, looping only if the kernel takes part
+ * of it. Returns 0 on success or -1 with errno set.
+ */
+int
+render_flush(struct render *render, int fd);
+
+// Tallest a tableau gets: six face down cards under a king to ace run
+#define RENDER_TABLEAU_ROWS 19
+
+// Lines the board takes on screen: the header, the tableaus label, the
+// tableau rows and a blank line. Whatever is printed after the board scrolls
+// below it.
+#define RENDER_SCREEN_LINES (RENDER_TABLEAU_ROWS + 3)
+
+// Places a card can be drawn: stock, waste, foundations and tableau rows
+#define RENDER_HEADER_CELLS (2 + NUM_FOUNDATION)
+#define RENDER_CELLS (RENDER_HEADER_CELLS + RENDER_TABLEAU_ROWS * NUM_TABLEAU)
+
+enum {
+    RENDER_CELL_BLANK = SOLITAIRE_DECK_SIZE,
+    RENDER_CELL_HIDDEN,         // Face down card or empty foundation, XX
+    RENDER_CELL_EMPTY,          // Empty stock, EE
+};
+
+/*
+ * The board as it was last drawn on a terminal. The board keeps a fixed place
+ * on screen, tableau rows anchored to the bottom of their area, so a move only
+ * changes the cells of the piles it touched. Each cell holds a card id or one
+ * of the RENDER_CELL_* values.
+ */
+struct render_screen {
+    uint8_t cells[RENDER_CELLS];
+    bool drawn;
+    struct render out;
+};
+
+/**
+ * render_screen_init - Start a screen that has not been drawn yet.
+ * @screen: struct render_screen * to set up
+ */
+void
+render_screen_init(struct render_screen *screen);
+
+/**
+ * render_screen_diff - Compose the updates that bring the screen to a board.
+ * @screen: struct render_screen * last drawn
+ * @field: struct field * to draw
+ *
+ * The first call clears the terminal, draws the whole board at the top and
+ * keeps any later output scrolling in the lines below it. After that only the
+ * cells that changed since the last call are drawn, each at its own cursor
+ * address, and the cursor is put back where it was. The updates land in
+ * screen->out for render_flush. Returns their length, 0 if nothing changed.
+ */
+size_t
+render_screen_diff(struct render_screen *screen, struct field *field);
+
+/**
+ * render_screen_end - Compose the updates that give the terminal back.
+ * @screen: struct render_screen * drawn with render_screen_diff
+ *
+ * Lets the whole terminal scroll again and puts the cursor on its last line.
+ * The updates land in screen->out for render_flush. Returns their length.
+ */
+size_t
+render_screen_end(struct render_screen *screen);
+
+#endif // SOLITAIRE_RENDER_H_
@@ -0,0 +1,76 @@
+#ifndef SOLITAIRE_RNG_H_
+#define SOLITAIRE_RNG_H_
+
+#include <stdint.h>
+
+/*
+ * xoshiro256** seeded through splitmix64. Everything is kept in the caller's
+ * struct rng, so any number of generators can run side by side on any thread,
+ * and the same seed gives the same stream on every platform.
+ */
+struct rng {
+    uint64_t s[4];
+};
+
+static inline uint64_t
+rng_splitmix64(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static inline void
+rng_seed(struct rng *rng, uint64_t seed)
+{
+    rng->s[0] = rng_splitmix64(&seed);
+    rng->s[1] = rng_splitmix64(&seed);
+    rng->s[2] = rng_splitmix64(&seed);
+    rng->s[3] = rng_splitmix64(&seed);
+}
+
+static inline uint64_t
+_rng_rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t
+rng_next(struct rng *rng)
+{
+    uint64_t *s = rng->s;
+    uint64_t result = _rng_rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = _rng_rotl(s[3], 45);
+    return result;
+}
+
+/**
+ * rng_bounded - Get an unbiased random number in [0, n).
+ * @rng: struct rng * to draw from
+ * @n: uint32_t upper bound, must not be 0
+ *
+ * Uses Lemire's multiply and reject method, which almost never loops.
+ */
+static inline uint32_t
+rng_bounded(struct rng *rng, uint32_t n)
+{
+    uint64_t m = (rng_next(rng) >> 32) * (uint64_t)n;
+    uint32_t low = (uint32_t)m;
+    if (low < n) {
+        uint32_t threshold = -n % n;
+        while (low < threshold) {
+            m = (rng_next(rng) >> 32) * (uint64_t)n;
+            low = (uint32_t)m;
+        }
+    }
+    return (uint32_t)(m >> 32);
+}
+
+#endif // SOLITAIRE_RNG_H_
@@ -0,0 +1,757 @@
+// accept4
+#define _GNU_SOURCE
+
+#include "server.h"
+#include "game.h"
+#include "rng.h"
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <malloc.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+// Requests read ahead of their answers, and answers waiting to be sent. A
+// connection stops reading while its answers back up.
+#define SESSION_IN_MAX (4 * SERVER_LINE_MAX)
+#define SESSION_OUT_MAX (16 * SERVER_LINE_MAX)
+
+#define SERVER_EVENTS 256
+
+// Sets of buffers kept for sessions to wake into, the rest are freed
+#define SESSION_SPARE_AWAKE 16
+
+/*
+ * What only a session that is in use needs: its game and its buffers. A
+ * session left idle for opts->idle_seconds hands these back, keeping its
+ * game frozen, and takes a set again with its next request. A few sets are
+ * kept spare, without a game, and the rest are freed.
+ */
+struct session_awake {
+    struct server_game game;
+    struct session_awake *next;     // Free list
+    size_t in_len;
+    size_t out_len;
+    char in[SESSION_IN_MAX];
+    char out[SESSION_OUT_MAX];
+};
+
+struct session {
+    struct session *prev;           // Its list in struct server, or the
+    struct session *next;           // free list by next
+    struct session_awake *awake;    // NULL while asleep
+    struct field_frozen frozen;     // The game while asleep
+    bool has_frozen;
+    int fd;
+    uint32_t events;                // What epoll is waiting on
+    bool eof;                       // Peer sent everything it will
+    bool closing;                   // Close once the answers are out
+    uint64_t last;                  // When it was last busy, in milliseconds
+};
+
+struct session_list {
+    struct session *head;
+    struct session *tail;
+};
+
+struct server {
+    struct server_opts *opts;
+    int epfd;
+    int lfd;
+    int sfd;
+    bool accepting;
+    int sessions;
+    struct session_list awake;      // Least recently busy first
+    struct session_list asleep;
+    struct session *free;
+    struct session_awake *free_awake;
+    int spare_awake;                // Sets on free_awake
+    uint64_t served;
+    uint64_t requests;
+    uint64_t sleeps;
+    uint64_t wakes;
+};
+
+static inline struct card *
+_parse_card(struct field *field, char const *str);
+
+static inline struct pile *
+_parse_pile(struct field *field, char const *str);
+
+static inline size_t
+_show(struct field *field, char *resp);
+
+static inline size_t
+_played(struct field *field, char *resp);
+
+static inline uint64_t
+_now_ms(void);
+
+static inline void
+_list_remove(struct session_list *list, struct session *s);
+
+static inline void
+_list_append(struct session_list *list, struct session *s);
+
+static int
+_listen(char const *path);
+
+static inline void
+_watch(struct server *srv, struct session *s, uint32_t events);
+
+static void
+_accept(struct server *srv);
+
+static void
+_session_close(struct server *srv, struct session *s);
+
+static struct session_awake *
+_awake_get(struct server *srv);
+
+static void
+_awake_put(struct server *srv, struct session_awake *awake);
+
+static void
+_session_sleep(struct server *srv, struct session *s);
+
+static void
+_session_wake(struct server *srv, struct session *s);
+
+static int
+_sessions_tire(struct server *srv);
+
+static inline bool
+_session_flush(struct session *s);
+
+static inline void
+_session_answer(struct server *srv, struct session *s);
+
+static void
+_session_io(struct server *srv, struct session *s, uint32_t events);
+
+// INTERNAL IMPLEMENTATION
+
+static inline struct card *
+_parse_card(struct field *field, char const *str)
+{
+    enum card_suit suit;
+    enum card_rank rank;
+    if (!card_parse(str, &suit, &rank))
+        return NULL;
+    return field_search(field, suit, rank);
+}
+
+static inline struct pile *
+_parse_pile(struct field *field, char const *str)
+{
+    if (str[0] == '\0' || str[1] < '1' || str[2] != '\0')
+        return NULL;
+    int i = str[1] - '1';
+    if (str[0] == 't' && i < NUM_TABLEAU)
+        return &field->tableaus[i];
+    if (str[0] == 'f' && i < NUM_FOUNDATION)
+        return &field->foundations[i];
+    return NULL;
+}
+
+static inline size_t
+_show(struct field *field, char *resp)
+{
+    size_t len = 0;
+    int i;
+
+    len += (size_t)snprintf(resp, SERVER_LINE_MAX, "ok %d ", field->stock.len);
+    len += card_str(pile_top_card(&field->waste), resp + len);
+    for (i = 0; i < NUM_FOUNDATION; ++i) {
+        resp[len++] = ' ';
+        len += card_str(pile_top_card(&field->foundations[i]), resp + len);
+    }
+    for (i = 0; i < NUM_TABLEAU; ++i) {
+        struct pile *pile = &field->tableaus[i];
+        // pile_get_nth_card counts from the top
+        int j = pile->len - 1;
+        while (j >= 0 && !pile_get_nth_card(pile, j)->face_up)
+            --j;
+        resp[len++] = ' ';
+        resp[len++] = (char)('0' + pile->len - 1 - j);
+        for (; j >= 0; --j)
+            len += card_str(pile_get_nth_card(pile, j), resp + len);
+    }
+    resp[len++] = '\n';
+    assert(len < SERVER_LINE_MAX);
+    resp[len] = '\0';
+    return len;
+}
+
+static inline size_t
+_played(struct field *field, char *resp)
+{
+    if (game_completion_check(field))
+        return (size_t)snprintf(resp, SERVER_LINE_MAX, "ok won\n");
+    if (dead_end_check(field))
+        return (size_t)snprintf(resp, SERVER_LINE_MAX, "ok dead\n");
+    return (size_t)snprintf(resp, SERVER_LINE_MAX, "ok\n");
+}
+
+static inline uint64_t
+_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static inline void
+_list_remove(struct session_list *list, struct session *s)
+{
+    if (s->prev != NULL)
+        s->prev->next = s->next;
+    else
+        list->head = s->next;
+    if (s->next != NULL)
+        s->next->prev = s->prev;
+    else
+        list->tail = s->prev;
+    s->prev = NULL;
+    s->next = NULL;
+}
+
+static inline void
+_list_append(struct session_list *list, struct session *s)
+{
+    s->prev = list->tail;
+    s->next = NULL;
+    if (list->tail != NULL)
+        list->tail->next = s;
+    else
+        list->head = s;
+    list->tail = s;
+}
+
+static int
+_listen(char const *path)
+{
+    struct sockaddr_un addr = { 0 };
+    struct stat st;
+
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    // Only ever replace a socket, never a file that happens to be in the way
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0
+        || listen(fd, SOMAXCONN) < 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    return fd;
+}
+
+// Changes what epoll waits on for a session, only when it has to
+static inline void
+_watch(struct server *srv, struct session *s, uint32_t events)
+{
+    if (s->events == events)
+        return;
+    struct epoll_event ev = { .events = events, .data.ptr = s };
+    if (epoll_ctl(srv->epfd, EPOLL_CTL_MOD, s->fd, &ev) < 0)
+        die("epoll_ctl");
+    s->events = events;
+}
+
+static void
+_accept(struct server *srv)
+{
+    for (;;) {
+        if (srv->opts->max_sessions > 0
+            && srv->sessions >= srv->opts->max_sessions) {
+            srv->accepting = false;
+            break;
+        }
+        int fd = accept4(srv->lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EMFILE || errno == ENFILE)
+                srv->accepting = false;
+            else if (errno != EAGAIN && errno != EINTR
+                && errno != ECONNABORTED)
+                perror("accept4");
+            break;
+        }
+
+        // Sessions start asleep without a game, so a connection that never
+        // sends anything costs no more than its struct session
+        struct session *s = srv->free;
+        if (s != NULL)
+            srv->free = s->next;
+        else if ((s = calloc(1, sizeof(*s))) == NULL)
+            die("calloc");
+        s->awake = NULL;
+        s->has_frozen = false;
+        s->fd = fd;
+        s->events = EPOLLIN;
+        s->eof = false;
+        s->closing = false;
+        s->last = _now_ms();
+        _list_append(&srv->asleep, s);
+
+        struct epoll_event ev = { .events = s->events, .data.ptr = s };
+        if (epoll_ctl(srv->epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+            die("epoll_ctl");
+        srv->sessions++;
+        srv->served++;
+    }
+
+    // Wait for sessions to end before taking more
+    if (!srv->accepting) {
+        struct epoll_event ev = { .events = 0, .data.ptr = NULL };
+        if (epoll_ctl(srv->epfd, EPOLL_CTL_MOD, srv->lfd, &ev) < 0)
+            die("epoll_ctl");
+    }
+}
+
+static void
+_session_close(struct server *srv, struct session *s)
+{
+    epoll_ctl(srv->epfd, EPOLL_CTL_DEL, s->fd, NULL);
+    close(s->fd);
+    s->fd = -1;
+    if (s->awake != NULL) {
+        _list_remove(&srv->awake, s);
+        _awake_put(srv, s->awake);
+        s->awake = NULL;
+    } else {
+        _list_remove(&srv->asleep, s);
+    }
+    if (s->has_frozen)
+        field_frozen_destroy(&s->frozen);
+    s->has_frozen = false;
+    s->next = srv->free;
+    srv->free = s;
+    srv->sessions--;
+
+    if (!srv->accepting) {
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+        if (epoll_ctl(srv->epfd, EPOLL_CTL_MOD, srv->lfd, &ev) < 0)
+            die("epoll_ctl");
+        srv->accepting = true;
+    }
+}
+
+static struct session_awake *
+_awake_get(struct server *srv)
+{
+    struct session_awake *awake = srv->free_awake;
+    if (awake != NULL) {
+        srv->free_awake = awake->next;
+        srv->spare_awake--;
+    } else if ((awake = calloc(1, sizeof(*awake))) == NULL) {
+        die("calloc");
+    }
+    awake->in_len = 0;
+    awake->out_len = 0;
+    return awake;
+}
+
+// The deck and field are destroyed even when the set is kept, or an idle
+// server would hold on to a game for every spare set
+static void
+_awake_put(struct server *srv, struct session_awake *awake)
+{
+    server_game_destroy(&awake->game);
+    if (srv->spare_awake >= SESSION_SPARE_AWAKE) {
+        free(awake);
+        return;
+    }
+    awake->next = srv->free_awake;
+    srv->free_awake = awake;
+    srv->spare_awake++;
+}
+
+// Freezes the game and gives the game storage and buffers back
+static void
+_session_sleep(struct server *srv, struct session *s)
+{
+    struct session_awake *awake = s->awake;
+    assert(awake->in_len == 0 && awake->out_len == 0);
+    if (awake->game.playing) {
+        field_freeze(&awake->game.field, &s->frozen);
+        s->has_frozen = true;
+    }
+    _awake_put(srv, awake);
+    s->awake = NULL;
+    _list_remove(&srv->awake, s);
+    _list_append(&srv->asleep, s);
+    srv->sleeps++;
+}
+
+static void
+_session_wake(struct server *srv, struct session *s)
+{
+    struct session_awake *awake = _awake_get(srv);
+    if (s->has_frozen) {
+        if (!field_thaw(&awake->game.field, &awake->game.deck, &s->frozen))
+            die("field_thaw");
+        awake->game.dealt = true;
+        awake->game.playing = true;
+        s->has_frozen = false;
+    }
+    s->awake = awake;
+    _list_remove(&srv->asleep, s);
+    _list_append(&srv->awake, s);
+    srv->wakes++;
+}
+
+// Puts the sessions idle for long enough to sleep. Returns the milliseconds
+// until the next one is due, or -1 if none is.
+static int
+_sessions_tire(struct server *srv)
+{
+    if (srv->opts->idle_seconds <= 0)
+        return -1;
+    // With no time to wait at all, sessions busy with answers would be put
+    // back to be looked at again forever, and the wait must fit the int
+    double ms = srv->opts->idle_seconds * 1000;
+    uint64_t idle = ms < 1 ? 1 : ms > INT_MAX ? INT_MAX : (uint64_t)ms;
+    uint64_t now = _now_ms();
+    uint64_t sleeps = srv->sleeps;
+    struct session *s;
+    while ((s = srv->awake.head) != NULL && s->last + idle <= now) {
+        // Answers the peer is slow to take keep the session up a while more
+        if (s->awake->in_len > 0 || s->awake->out_len > 0) {
+            s->last = now;
+            _list_remove(&srv->awake, s);
+            _list_append(&srv->awake, s);
+            continue;
+        }
+        _session_sleep(srv, s);
+    }
+    // free keeps what it is given for later mallocs, hand the pages back so
+    // the sleepers' memory really goes
+    if (srv->sleeps != sleeps)
+        malloc_trim(0);
+    return s == NULL ? -1 : (int)(s->last + idle - now);
+}
+
+// Sends what it can of the answers. Returns false if the peer is gone.
+static inline bool
+_session_flush(struct session *s)
+{
+    struct session_awake *a = s->awake;
+    size_t done = 0;
+    while (done < a->out_len) {
+        ssize_t n = send(s->fd, a->out + done, a->out_len - done,
+            MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN)
+                break;
+            return false;
+        }
+        done += (size_t)n;
+    }
+    memmove(a->out, a->out + done, a->out_len - done);
+    a->out_len -= done;
+    return true;
+}
+
+// Answers every whole request line read so far, while the answers fit
+static inline void
+_session_answer(struct server *srv, struct session *s)
+{
+    struct session_awake *a = s->awake;
+    size_t start = 0;
+    while (!s->closing && a->out_len + SERVER_LINE_MAX <= SESSION_OUT_MAX) {
+        char *line = a->in + start;
+        char *nl = memchr(line, '\n', a->in_len - start);
+        if (nl == NULL)
+            break;
+        *nl = '\0';
+        if (nl > line && nl[-1] == '\r')
+            nl[-1] = '\0';
+        start = (size_t)(nl - a->in) + 1;
+
+        if (strcmp(line, "quit") == 0)
+            s->closing = true;
+        a->out_len += server_request(&a->game, line, a->out + a->out_len);
+        srv->requests++;
+    }
+    memmove(a->in, a->in + start, a->in_len - start);
+    a->in_len -= start;
+
+    // A line that can not fit is never going to end
+    if (!s->closing && a->in_len == SESSION_IN_MAX
+        && a->out_len + SERVER_LINE_MAX <= SESSION_OUT_MAX) {
+        a->out_len += (size_t)snprintf(a->out + a->out_len, SERVER_LINE_MAX,
+            "err line too long\n");
+        s->closing = true;
+    }
+}
+
+static void
+_session_io(struct server *srv, struct session *s, uint32_t events)
+{
+    if (events & EPOLLERR) {
+        _session_close(srv, s);
+        return;
+    }
+
+    if (s->awake == NULL) {
+        _session_wake(srv, s);
+    } else {
+        _list_remove(&srv->awake, s);
+        _list_append(&srv->awake, s);
+    }
+    struct session_awake *a = s->awake;
+    s->last = _now_ms();
+
+    // One read per wakeup, epoll says again if there is more, which keeps a
+    // busy client from starving the others
+    if ((events & (EPOLLIN | EPOLLHUP)) && !s->eof
+        && a->in_len < SESSION_IN_MAX) {
+        ssize_t n = read(s->fd, a->in + a->in_len,
+            SESSION_IN_MAX - a->in_len);
+        if (n > 0)
+            a->in_len += (size_t)n;
+        else if (n == 0)
+            s->eof = true;
+        else if (errno != EAGAIN && errno != EINTR) {
+            _session_close(srv, s);
+            return;
+        }
+    }
+
+    // Answer, send, and answer again what was held back for room
+    do {
+        _session_answer(srv, s);
+        if (!_session_flush(s)) {
+            _session_close(srv, s);
+            return;
+        }
+    } while (a->out_len == 0 && !s->closing
+        && memchr(a->in, '\n', a->in_len));
+
+    if ((s->eof || s->closing) && a->out_len == 0) {
+        _session_close(srv, s);
+        return;
+    }
+
+    uint32_t want = 0;
+    if (!s->eof && !s->closing && a->in_len < SESSION_IN_MAX)
+        want |= EPOLLIN;
+    if (a->out_len > 0)
+        want |= EPOLLOUT;
+    _watch(srv, s, want);
+}
+
+// EXTERNAL / PUBLIC FUNCTIONS
+
+void
+server_opts_default(struct server_opts *opts)
+{
+    memset(opts, 0, sizeof(struct server_opts));
+    opts->idle_seconds = 30;
+}
+
+size_t
+server_request(struct server_game *game, char *req, char *resp)
+{
+    struct field *field = &game->field;
+    char *arg = strchr(req, ' ');
+    if (arg != NULL)
+        *arg++ = '\0';
+
+    if (strcmp(req, "new") == 0) {
+        uint64_t seed;
+        if (arg != NULL) {
+            char *end;
+            errno = 0;
+            seed = strtoull(arg, &end, 10);
+            if (errno != 0 || end == arg || *end != '\0')
+                return (size_t)snprintf(resp, SERVER_LINE_MAX,
+                    "err bad deal number\n");
+        } else {
+            // Same mix as deck_init, the game's address tells sessions apart
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            uint64_t state = (uint64_t)ts.tv_sec * 1000000000ULL
+                + (uint64_t)ts.tv_nsec;
+            state ^= (uint64_t)(uintptr_t)game;
+            seed = rng_splitmix64(&state);
+        }
+        if (game->dealt) {
+            field_reset(field, seed);
+        } else {
+            deck_init_seeded(&game->deck, seed);
+            field_init(field, &game->deck);
+            game->dealt = true;
+        }
+        game->playing = true;
+        return (size_t)snprintf(resp, SERVER_LINE_MAX, "ok %" PRIu64 "\n",
+            seed);
+    }
+
+    // The rest take no arguments. quit in particular must answer ok only for
+    // the line _session_answer closes the connection on.
+    if (arg != NULL && (strcmp(req, "quit") == 0 || strcmp(req, "show") == 0
+            || strcmp(req, "deal") == 0 || strcmp(req, "undo") == 0))
+        return (size_t)snprintf(resp, SERVER_LINE_MAX, "err bad request\n");
+
+    if (strcmp(req, "quit") == 0)
+        return (size_t)snprintf(resp, SERVER_LINE_MAX, "ok\n");
+
+    if (!game->playing)
+        return (size_t)snprintf(resp, SERVER_LINE_MAX, "err no game\n");
+
+    if (strcmp(req, "show") == 0)
+        return _show(field, resp);
+
+    if (strcmp(req, "deal") == 0) {
+        if (!deal_card(field))
+            return (size_t)snprintf(resp, SERVER_LINE_MAX,
+                "err nothing to deal\n");
+        return _played(field, resp);
+    }
+
+    if (strcmp(req, "undo") == 0) {
+        if (field->history.cnt == 0)
+            return (size_t)snprintf(resp, SERVER_LINE_MAX,
+                "err nothing to undo\n");
+        undo_move(field);
+        return _played(field, resp);
+    }
+
+    if (arg == NULL)
+        return (size_t)snprintf(resp, SERVER_LINE_MAX, "err bad request\n");
+    struct card *card = _parse_card(field, req);
+    if (card == NULL)
+        return (size_t)snprintf(resp, SERVER_LINE_MAX, "err bad card\n");
+    struct pile *pile = _parse_pile(field, arg);
+    if (pile == NULL)
+        return (size_t)snprintf(resp, SERVER_LINE_MAX, "err bad pile\n");
+    enum move_status status = field_play(field, card, pile);
+    if (status != MOVE_OK)
+        return (size_t)snprintf(resp, SERVER_LINE_MAX, "err %s\n",
+            move_status_str(status));
+    return _played(field, resp);
+}
+
+void
+server_game_destroy(struct server_game *game)
+{
+    if (!game->dealt)
+        return;
+    field_destroy(&game->field);
+    deck_destroy(&game->deck);
+    game->dealt = false;
+    game->playing = false;
+}
+
+int
+server_run(struct server_opts *opts)
+{
+    struct server srv = { 0 };
+    struct epoll_event events[SERVER_EVENTS];
+    struct signalfd_siginfo info;
+    sigset_t mask;
+
+    srv.opts = opts;
+    srv.accepting = true;
+
+    // Signals come in as a readable descriptor, so a stop is just one more
+    // event and never lands in the middle of a session
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    if (sigprocmask(SIG_BLOCK, &mask, NULL) < 0)
+        return -1;
+    srv.sfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    srv.lfd = _listen(opts->path);
+    srv.epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (srv.sfd < 0 || srv.lfd < 0 || srv.epfd < 0) {
+        int err = errno;
+        if (srv.sfd >= 0)
+            close(srv.sfd);
+        if (srv.lfd >= 0)
+            close(srv.lfd);
+        sigprocmask(SIG_UNBLOCK, &mask, NULL);
+        errno = err;
+        return -1;
+    }
+
+    // The listening socket and the signals are told apart by their data
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+    epoll_ctl(srv.epfd, EPOLL_CTL_ADD, srv.lfd, &ev);
+    ev.data.ptr = &srv;
+    epoll_ctl(srv.epfd, EPOLL_CTL_ADD, srv.sfd, &ev);
+
+    bool running = true;
+    while (running) {
+        int n = epoll_wait(srv.epfd, events, SERVER_EVENTS,
+            _sessions_tire(&srv));
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            die("epoll_wait");
+        }
+        int i;
+        for (i = 0; i < n; ++i) {
+            void *ptr = events[i].data.ptr;
+            if (ptr == NULL)
+                _accept(&srv);
+            else if (ptr == &srv)
+                running = read(srv.sfd, &info, sizeof(info)) <= 0;
+            else
+                _session_io(&srv, ptr, events[i].events);
+        }
+    }
+
+    while (srv.awake.head != NULL)
+        _session_close(&srv, srv.awake.head);
+    while (srv.asleep.head != NULL)
+        _session_close(&srv, srv.asleep.head);
+
+    struct session *s;
+    while ((s = srv.free) != NULL) {
+        srv.free = s->next;
+        free(s);
+    }
+    struct session_awake *a;
+    while ((a = srv.free_awake) != NULL) {
+        srv.free_awake = a->next;
+        free(a);
+    }
+    close(srv.epfd);
+    close(srv.lfd);
+    close(srv.sfd);
+    unlink(opts->path);
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+
+    fprintf(stderr, "sessions: %llu requests: %llu sleeps: %llu wakes: %llu\n",
+        (unsigned long long)srv.served,
+        (unsigned long long)srv.requests,
+        (unsigned long long)srv.sleeps,
+        (unsigned long long)srv.wakes);
+    return 0;
+}
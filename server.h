@@ -0,0 +1,99 @@
+#ifndef SOLITAIRE_SERVER_H_
+#define SOLITAIRE_SERVER_H_
+
+#include "card_type.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Longest request or response line, newline included
+#define SERVER_LINE_MAX 256
+
+struct server_opts {
+    char const *path;           // Unix socket to listen on
+    int max_sessions;           // Connections served at once, 0 for no limit
+    double idle_seconds;        // Idle time before a session sleeps, 0 never
+};
+
+/*
+ * The game of a connection. The deck and field are set up by the first "new"
+ * and dealt into again by every later one, so game after game is played
+ * without touching the heap while the connection stays busy. A connection
+ * that falls idle frees them, keeping only a frozen copy of its position and
+ * history from field_freeze. Its next request sets up a deck and field again
+ * and thaws the game into them.
+ */
+struct server_game {
+    struct deck deck;
+    struct field field;
+    bool dealt;                 // The deck and field are set up
+    bool playing;               // A game was dealt on this connection
+};
+
+/**
+ * server_request - Answer one request line of the server protocol.
+ * @game: struct server_game * of the connection
+ * @req: char * request without its newline, modified in place
+ * @resp: char * buffer of SERVER_LINE_MAX bytes for the response
+ *
+ * Requests are:
+ *
+ *   new [N]       Deal number N, or a new deal. Answers "ok N".
+ *   deal          Deal a card from the stock, or recycle the waste.
+ *   undo          Take back the last move.
+ *   CARD PILE     Move a card, and any cards on it, as in "as f1" or "kd t3".
+ *   show          Answers "ok" followed by the stock count, the waste top,
+ *                 the four foundation tops and the seven tableaus. A card is
+ *                 its rank and suit as in moves, "--" for none. A tableau is
+ *                 its count of face down cards then its face up cards from
+ *                 the bottom, as in "3kdqs".
+ *   quit          Answers "ok" and closes the connection.
+ *
+ * deal, undo and moves answer "ok", "ok won" once every card is on the
+ * foundations or "ok dead" once dead_end_check finds no useful move left.
+ * That check can miss a way out, so play goes on being accepted after "ok
+ * dead". Anything that fails answers "err" and a reason, leaving the game as
+ * it was.
+ *
+ * The response is NUL terminated. Returns its length, newline included.
+ */
+size_t
+server_request(struct server_game *game, char *req, char *resp);
+
+void
+server_game_destroy(struct server_game *game);
+
+/**
+ * server_opts_default - Fill in the default server options.
+ * @opts: struct server_opts * to fill in, path is left NULL
+ */
+void
+server_opts_default(struct server_opts *opts);
+
+/**
+ * server_run - Serve games to many clients from one thread.
+ * @opts: struct server_opts * with the socket path
+ *
+ * Listens on a Unix stream socket and waits on every connection with epoll.
+ * Each connection sends request lines and gets one response line for each,
+ * in order, so clients may send many requests before reading the answers.
+ * A stale socket file left at the path is replaced.
+ *
+ * A session idle for opts->idle_seconds goes to sleep: its game is frozen
+ * with field_freeze, its deck and field are destroyed and its buffers are
+ * freed, bar a few kept spare, leaving little more than the position and
+ * the history. Its next request thaws the
+ * game before it is answered, so clients can not tell. A connection that has
+ * not asked for anything yet starts asleep.
+ *
+ * Runs until SIGINT or SIGTERM, then removes the socket file and prints the
+ * sessions served, requests answered and sessions put to sleep and woken to
+ * stderr.
+ *
+ * Returns 0 on a clean stop or -1 with errno set if the socket could not be
+ * set up.
+ */
+int
+server_run(struct server_opts *opts);
+
+#endif // SOLITAIRE_SERVER_H_
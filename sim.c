@@ -0,0 +1,307 @@
+#include "sim.h"
+#include "game.h"
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+static inline double
+_now(void);
+
+static inline bool
+_loc_is_foundation(enum card_location loc);
+
+static inline bool
+_loc_is_tableau(enum card_location loc);
+
+static inline int
+_greedy_score(struct field *field, struct card_move *move);
+
+static int
+_policy_random(
+    struct field *field,
+    struct card_move *moves,
+    int cnt,
+    struct rng *rng
+    );
+
+static int
+_policy_greedy(
+    struct field *field,
+    struct card_move *moves,
+    int cnt,
+    struct rng *rng
+    );
+
+static int
+_policy_foundation_first(
+    struct field *field,
+    struct card_move *moves,
+    int cnt,
+    struct rng *rng
+    );
+
+static sim_policy_fn const _policies[SIM_POLICY_MAX] = {
+    [SIM_RANDOM] = _policy_random,
+    [SIM_GREEDY] = _policy_greedy,
+    [SIM_FOUNDATION_FIRST] = _policy_foundation_first,
+};
+
+static char const *const _policy_names[SIM_POLICY_MAX] = {
+    [SIM_RANDOM] = "random",
+    [SIM_GREEDY] = "greedy",
+    [SIM_FOUNDATION_FIRST] = "foundation-first",
+};
+
+// INTERNAL IMPLEMENTATION
+
+static inline double
+_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static inline bool
+_loc_is_foundation(enum card_location loc)
+{
+    return loc >= LOC_FOUND0 && loc <= LOC_FOUND3;
+}
+
+static inline bool
+_loc_is_tableau(enum card_location loc)
+{
+    return loc >= LOC_TAB0 && loc <= LOC_TAB6;
+}
+
+// Higher is better. Moves that only shuffle cards around score below zero.
+static inline int
+_greedy_score(struct field *field, struct card_move *move)
+{
+    // Deal or recycle
+    if (move->src == LOC_STOCK || move->dst == LOC_STOCK)
+        return 1;
+
+    if (_loc_is_foundation(move->src))
+        return -10;
+
+    struct pile *src_pile = field_pile(field, move->src);
+    struct pile *dst_pile = field_pile(field, move->dst);
+    struct card *below = pile_get_nth_card(src_pile, move->cnt);
+    bool reveals = _loc_is_tableau(move->src) && below != NULL
+        && !below->face_up;
+
+    if (_loc_is_foundation(move->dst))
+        return reveals ? 110 : 100;
+    if (reveals)
+        return 50;
+    if (move->src == LOC_WASTE)
+        return 20;
+
+    // A whole pile moving to an empty tableau gains nothing
+    if (below == NULL)
+        return pile_empty(dst_pile) ? -20 : 10;
+    return -1;
+}
+
+static int
+_policy_random(
+    struct field *field,
+    struct card_move *moves,
+    int cnt,
+    struct rng *rng
+    )
+{
+    return (int)rng_bounded(rng, (uint32_t)cnt);
+}
+
+// Ties are broken at random, keeping each of the best moves with equal odds
+static int
+_policy_greedy(
+    struct field *field,
+    struct card_move *moves,
+    int cnt,
+    struct rng *rng
+    )
+{
+    int best = 0;
+    int best_score = _greedy_score(field, &moves[0]);
+    uint32_t ties = 1;
+    int i;
+    for (i = 1; i < cnt; ++i) {
+        int score = _greedy_score(field, &moves[i]);
+        if (score > best_score) {
+            best = i;
+            best_score = score;
+            ties = 1;
+        } else if (score == best_score && rng_bounded(rng, ++ties) == 0) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+static int
+_policy_foundation_first(
+    struct field *field,
+    struct card_move *moves,
+    int cnt,
+    struct rng *rng
+    )
+{
+    int i;
+    for (i = 0; i < cnt; ++i)
+        if (_loc_is_foundation(moves[i].dst))
+            return i;
+    return _policy_random(field, moves, cnt, rng);
+}
+
+// EXTERNAL / PUBLIC FUNCTIONS
+
+void
+sim_opts_default(struct sim_opts *opts)
+{
+    memset(opts, 0, sizeof(struct sim_opts));
+    opts->games = 1000;
+    opts->policy = SIM_GREEDY;
+    opts->max_stall = 500;
+}
+
+bool
+sim_play(
+    struct field *field,
+    sim_policy_fn policy,
+    struct rng *rng,
+    int max_stall,
+    int *moves
+    )
+{
+    struct card_move buf[FIELD_MAX_MOVES];
+    int best_found = 0;
+    int best_down = SOLITAIRE_DECK_SIZE;
+    int best_stock = SOLITAIRE_DECK_SIZE;
+    int played = 0;
+    int stall = 0;
+    bool won = false;
+
+    for (;;) {
+        if (game_completion_check(field)) {
+            won = true;
+            break;
+        }
+        if (stall >= max_stall)
+            break;
+
+        int cnt = field_gen_moves(field, buf, FIELD_MAX_MOVES);
+        if (cnt == 0)
+            break;
+        if (cnt > FIELD_MAX_MOVES)
+            cnt = FIELD_MAX_MOVES;
+        field_apply_move(field, &buf[policy(field, buf, cnt, rng)]);
+        played++;
+
+        // Progress is anything that can never be undone by moves forward
+        int found = 0;
+        int down = 0;
+        int stock = field->stock.len + field->waste.len;
+        int i;
+        int j;
+        for (i = 0; i < NUM_FOUNDATION; ++i)
+            found += field->foundations[i].len;
+        for (i = 0; i < NUM_TABLEAU; ++i) {
+            struct pile *pile = &field->tableaus[i];
+            for (j = 0; j < pile->len; ++j) {
+                if (pile_get_nth_card(pile, pile->len - 1 - j)->face_up)
+                    break;
+                down++;
+            }
+        }
+        stall++;
+        if (found > best_found || down < best_down || stock < best_stock)
+            stall = 0;
+        if (found > best_found)
+            best_found = found;
+        if (down < best_down)
+            best_down = down;
+        if (stock < best_stock)
+            best_stock = stock;
+    }
+
+    if (moves != NULL)
+        *moves = played;
+    return won;
+}
+
+void
+sim_run(struct sim_opts *opts, struct sim_stats *stats)
+{
+    sim_policy_fn policy = sim_policy_get(opts->policy);
+    double start = _now();
+    struct deck deck = { 0 };
+    struct field field;
+    uint64_t i;
+
+    // Every game is dealt into the same field, so games do not touch the heap
+    memset(stats, 0, sizeof(struct sim_stats));
+    deck_init_seeded(&deck, opts->first);
+    field_init(&field, &deck);
+    for (i = 0; i < opts->games; ++i) {
+        struct rng rng;
+        int moves;
+
+        field_reset(&field, opts->first + i);
+        // Keep the policy's stream apart from the shuffle's
+        rng_seed(&rng, ~deck.seed);
+        stats->won += sim_play(&field, policy, &rng, opts->max_stall, &moves);
+        stats->moves += (uint64_t)moves;
+        stats->games++;
+    }
+    field_destroy(&field);
+    deck_destroy(&deck);
+    stats->seconds = _now() - start;
+}
+
+void
+sim_wilson(uint64_t won, uint64_t games, double z, double *lo, double *hi)
+{
+    if (games == 0) {
+        *lo = 0;
+        *hi = 1;
+        return;
+    }
+
+    double n = (double)games;
+    double p = (double)won / n;
+    double z2 = z * z;
+    double center = (p + z2 / (2 * n)) / (1 + z2 / n);
+    double half = z / (1 + z2 / n)
+        * sqrt(p * (1 - p) / n + z2 / (4 * n * n));
+    *lo = center - half < 0 ? 0 : center - half;
+    *hi = center + half > 1 ? 1 : center + half;
+}
+
+sim_policy_fn
+sim_policy_get(enum sim_policy policy)
+{
+    if (policy < 0 || policy >= SIM_POLICY_MAX)
+        return NULL;
+    return _policies[policy];
+}
+
+char const *
+sim_policy_str(enum sim_policy policy)
+{
+    if (policy < 0 || policy >= SIM_POLICY_MAX)
+        return "unknown";
+    return _policy_names[policy];
+}
+
+enum sim_policy
+sim_policy_parse(char const *name)
+{
+    enum sim_policy policy;
+    for (policy = 0; policy < SIM_POLICY_MAX; ++policy)
+        if (strcmp(name, _policy_names[policy]) == 0)
+            return policy;
+    return SIM_POLICY_MAX;
+}
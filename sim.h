@@ -0,0 +1,111 @@
+#ifndef SOLITAIRE_SIM_H_
+#define SOLITAIRE_SIM_H_
+
+#include "card_type.h"
+#include "rng.h"
+#include <stdint.h>
+
+enum sim_policy {
+    SIM_RANDOM,             // Any legal move
+    SIM_GREEDY,             // The best move by a fixed score
+    SIM_FOUNDATION_FIRST,   // Foundation moves first, any legal move otherwise
+    SIM_POLICY_MAX,
+};
+
+/*
+ * A policy picks one of the cnt legal moves of the field and returns its
+ * index. cnt is always at least 1.
+ */
+typedef int (*sim_policy_fn)(
+    struct field *field,
+    struct card_move *moves,
+    int cnt,
+    struct rng *rng
+    );
+
+struct sim_opts {
+    uint64_t first;         // Deal number of the first game
+    uint64_t games;         // Number of games to play
+    enum sim_policy policy;
+    int max_stall;          // Moves without progress before giving up
+};
+
+struct sim_stats {
+    uint64_t games;
+    uint64_t won;
+    uint64_t moves;
+    double seconds;
+};
+
+/**
+ * sim_opts_default - Fill in the default simulation options.
+ * @opts: struct sim_opts * to fill in
+ */
+void
+sim_opts_default(struct sim_opts *opts);
+
+/**
+ * sim_play - Play one game to the end with a policy.
+ * @field: struct field * to play, left in its final position
+ * @policy: sim_policy_fn picking each move
+ * @rng: struct rng * the policy may draw from
+ * @max_stall: moves without progress before the game counts as lost
+ * @moves: int * to store the number of moves played in, or NULL
+ *
+ * Moves come from field_gen_moves and are played with field_apply_move. The
+ * game is lost when there are no moves at all, or when max_stall moves go by
+ * without a new card on the foundations, a new card turned up on the
+ * tableaus or a card taken out of the stock and waste. dead_end_check is not
+ * used, as it misses moves such as splitting a run to free a card for a
+ * foundation, and would count some winnable games as lost. Nothing is
+ * printed.
+ *
+ * Returns true if the game was won.
+ */
+bool
+sim_play(
+    struct field *field,
+    sim_policy_fn policy,
+    struct rng *rng,
+    int max_stall,
+    int *moves
+    );
+
+/**
+ * sim_run - Play a range of deals with one policy.
+ * @opts: struct sim_opts * describing the games
+ * @stats: struct sim_stats * to fill in
+ *
+ * Game i plays deal opts->first + i, and its policy draws from a generator
+ * seeded by the deal number, so a run can always be repeated.
+ */
+void
+sim_run(struct sim_opts *opts, struct sim_stats *stats);
+
+/**
+ * sim_wilson - Get the Wilson score interval of a win rate.
+ * @won: games won
+ * @games: games played
+ * @z: standard score of the confidence level, 1.96 for 95%
+ * @lo: double * to store the lower bound in
+ * @hi: double * to store the upper bound in
+ */
+void
+sim_wilson(uint64_t won, uint64_t games, double z, double *lo, double *hi);
+
+sim_policy_fn
+sim_policy_get(enum sim_policy policy);
+
+char const *
+sim_policy_str(enum sim_policy policy);
+
+/**
+ * sim_policy_parse - Look a policy up by the name sim_policy_str gives it.
+ * @name: char const * to look up
+ *
+ * Returns SIM_POLICY_MAX if there is no such policy.
+ */
+enum sim_policy
+sim_policy_parse(char const *name);
+
+#endif // SOLITAIRE_SIM_H_
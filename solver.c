@@ -0,0 +1,477 @@
+#include "solver.h"
+#include "game.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SOLVER_CLOCK_INTERVAL 4096
+
+// Transposition table entries are grouped in buckets of this many slots. The
+// top byte of an entry holds the generation of the search that stored it, so
+// the table does not need clearing between searches.
+#define TT_WAYS 4
+#define TT_GEN_SHIFT 56
+#define TT_KEY_MASK ((1ULL << TT_GEN_SHIFT) - 1)
+
+// Order in which the search tries moves, lowest first
+enum move_priority {
+    PRIO_SKIP = -1,
+    PRIO_SAFE,
+    PRIO_FOUNDATION,
+    PRIO_REVEAL,
+    PRIO_EMPTY_TABLEAU,
+    PRIO_WASTE,
+    PRIO_FREE,
+    PRIO_FROM_FOUNDATION,
+    PRIO_DEAL,
+    PRIO_PRUNED,        // Only tried by the exact search
+    PRIO_MAX,
+};
+
+static inline double
+_now(void);
+
+static inline void
+_solver_reserve(struct solver *solver, int depth);
+
+static inline bool
+_tt_insert(struct solver *solver, uint64_t hash);
+
+static inline uint64_t
+_card_bit(struct card *card);
+
+static inline bool
+_field_won(struct field *field);
+
+static inline uint64_t
+_field_seen(struct field *field);
+
+static inline void
+_foundation_counts(struct field *field, int counts[SUIT_MAX]);
+
+static inline bool
+_card_is_safe(struct card *card, int counts[SUIT_MAX]);
+
+static inline enum move_priority
+_move_priority(
+    struct field *field,
+    struct card_move *move,
+    int *counts,
+    bool exact
+    );
+
+static inline void
+_solver_gen(struct solver *solver, struct field *field, int depth);
+
+static enum solve_result
+_solver_search(struct solver *solver, struct field *field, double start);
+
+static inline bool
+_move_reveals(struct field *field, struct card_move *move, uint64_t *seen);
+
+// INTERNAL IMPLEMENTATION
+
+static inline double
+_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Makes room for one more frame at depth and a full list of moves for it
+static inline void
+_solver_reserve(struct solver *solver, int depth)
+{
+    if (depth >= solver->frames_cap) {
+        solver->frames_cap *= 2;
+        solver->frames = realloc(
+            solver->frames,
+            sizeof(struct solve_frame) * (size_t)solver->frames_cap
+            );
+        if (solver->frames == NULL)
+            die("realloc");
+    }
+
+    int start = depth == 0 ? 0
+        : solver->frames[depth - 1].start + solver->frames[depth - 1].cnt;
+    if (start + FIELD_MAX_MOVES > solver->moves_cap) {
+        while (start + FIELD_MAX_MOVES > solver->moves_cap)
+            solver->moves_cap *= 2;
+        solver->moves = realloc(
+            solver->moves,
+            sizeof(struct card_move) * (size_t)solver->moves_cap
+            );
+        if (solver->moves == NULL)
+            die("realloc");
+    }
+}
+
+// Returns false if the position was already in the table
+static inline bool
+_tt_insert(struct solver *solver, uint64_t hash)
+{
+    uint64_t entry = (hash & TT_KEY_MASK) | (solver->tt_gen << TT_GEN_SHIFT);
+    uint64_t *bucket = solver->tt
+        + (hash & solver->tt_mask & ~(TT_WAYS - 1ULL));
+    int i;
+    for (i = 0; i < TT_WAYS; ++i) {
+        if (bucket[i] == entry)
+            return false;
+        if ((bucket[i] >> TT_GEN_SHIFT) != solver->tt_gen) {
+            bucket[i] = entry;
+            return true;
+        }
+    }
+    bucket[(hash >> 32) % TT_WAYS] = entry;
+    return true;
+}
+
+static inline uint64_t
+_card_bit(struct card *card)
+{
+    return 1ULL << card_id(card);
+}
+
+static inline bool
+_field_won(struct field *field)
+{
+    int cnt = 0;
+    int i;
+    for (i = 0; i < NUM_FOUNDATION; ++i)
+        cnt += pile_count(&field->foundations[i]);
+    return cnt == SOLITAIRE_DECK_SIZE;
+}
+
+// Cards the player has seen, which at the start is every face up card
+static inline uint64_t
+_field_seen(struct field *field)
+{
+    uint64_t seen = 0;
+    struct card *card;
+    int loc;
+    int i;
+    for (loc = LOC_STOCK; loc <= LOC_FOUND3; ++loc)
+        pile_for_each_card(card, i, field_pile(field, loc))
+            if (card->face_up)
+                seen |= _card_bit(card);
+    return seen;
+}
+
+// Number of cards of each suit on the foundations
+static inline void
+_foundation_counts(struct field *field, int counts[SUIT_MAX])
+{
+    memset(counts, 0, sizeof(int) * SUIT_MAX);
+    int i;
+    for (i = 0; i < NUM_FOUNDATION; ++i) {
+        struct card *card = pile_top_card(&field->foundations[i]);
+        if (card != NULL)
+            counts[card->suit] = card->rank + 1;
+    }
+}
+
+// A card can go to the foundation without ever being needed back on a tableau
+// once both opposite colored cards one rank lower are on the foundations.
+static inline bool
+_card_is_safe(struct card *card, int counts[SUIT_MAX])
+{
+    if (card->rank <= RANK_2)
+        return true;
+    int suit;
+    for (suit = SUIT_SPADE; suit < SUIT_MAX; ++suit)
+        if ((suit & 0x1) != (card->suit & 0x1)
+            && counts[suit] < (int)card->rank)
+            return false;
+    return true;
+}
+
+static inline enum move_priority
+_move_priority(
+    struct field *field,
+    struct card_move *move,
+    int *counts,
+    bool exact
+    )
+{
+    if (move->src == LOC_STOCK || move->dst == LOC_STOCK)
+        return PRIO_DEAL;
+
+    struct pile *src_pile = field_pile(field, move->src);
+    struct pile *dst_pile = field_pile(field, move->dst);
+    struct card *card = pile_get_nth_card(src_pile, move->cnt - 1);
+    struct card *below = pile_get_nth_card(src_pile, move->cnt);
+
+    if (_PILE_IS_FOUNDATION(dst_pile))
+        return _card_is_safe(card, counts) ? PRIO_SAFE : PRIO_FOUNDATION;
+    if (_PILE_IS_FOUNDATION(src_pile))
+        return PRIO_FROM_FOUNDATION;
+    if (!_PILE_IS_TABLEAU(src_pile))
+        return PRIO_WASTE;
+
+    // Moving a whole tableau only helps if it leaves an empty tableau behind
+    if (below == NULL) {
+        if (!pile_empty(dst_pile))
+            return PRIO_EMPTY_TABLEAU;
+        return exact ? PRIO_PRUNED : PRIO_SKIP;
+    }
+    if (!below->face_up)
+        return PRIO_REVEAL;
+
+    // Splitting a face up run mostly helps when it frees a card for a
+    // foundation
+    if (counts[below->suit] == (int)below->rank)
+        return PRIO_FREE;
+    return exact ? PRIO_PRUNED : PRIO_SKIP;
+}
+
+static inline void
+_solver_gen(struct solver *solver, struct field *field, int depth)
+{
+    struct card_move buf[FIELD_MAX_MOVES];
+    signed char prio[FIELD_MAX_MOVES];
+    int counts[SUIT_MAX];
+    int cnt = field_gen_moves(field, buf, FIELD_MAX_MOVES);
+    int i;
+
+    _solver_reserve(solver, depth);
+    struct solve_frame *frame = &solver->frames[depth];
+    frame->start = depth == 0 ? 0
+        : solver->frames[depth - 1].start + solver->frames[depth - 1].cnt;
+    frame->cnt = 0;
+    frame->next = 0;
+    frame->committed = false;
+    struct card_move *moves = solver->moves + frame->start;
+
+    _foundation_counts(field, counts);
+    for (i = 0; i < cnt; ++i) {
+        prio[i] = (signed char)_move_priority(field, &buf[i], counts,
+            solver->exact);
+        // A safe foundation move is always played first and alone
+        if (prio[i] == PRIO_SAFE) {
+            moves[frame->cnt++] = buf[i];
+            return;
+        }
+    }
+
+    int p;
+    for (p = 0; p < PRIO_MAX; ++p)
+        for (i = 0; i < cnt; ++i)
+            if (prio[i] == p)
+                moves[frame->cnt++] = buf[i];
+}
+
+// Checks whether a move shows a card the player has not seen yet, and adds
+// whatever the move shows to seen.
+static inline bool
+_move_reveals(struct field *field, struct card_move *move, uint64_t *seen)
+{
+    struct card *card = NULL;
+    if (move->src == LOC_STOCK) {
+        card = pile_top_card(&field->stock);
+    } else if (move->dst != LOC_STOCK) {
+        card = pile_get_nth_card(field_pile(field, move->src), move->cnt);
+        if (card != NULL && card->face_up)
+            card = NULL;
+    }
+
+    if (card == NULL || (*seen & _card_bit(card)))
+        return false;
+    *seen |= _card_bit(card);
+    return true;
+}
+
+// Searches the field, trying the moves it usually skips if solver->exact is
+// set. Node counts and time limits carry over from earlier searches.
+static enum solve_result
+_solver_search(struct solver *solver, struct field *field, double start)
+{
+    enum solve_result result = SOLVE_LOST;
+    int depth = 0;
+
+    // Start a new generation, clearing the table only when the tag wraps
+    solver->tt_gen = (solver->tt_gen + 1) & 0xff;
+    if (solver->tt_gen == 0) {
+        memset(solver->tt, 0, sizeof(uint64_t) * (solver->tt_mask + 1));
+        solver->tt_gen = 1;
+    }
+
+    _tt_insert(solver, field_hash(field));
+    _solver_gen(solver, field, 0);
+    solver->frames[0].seen = _field_seen(field);
+
+    while (true) {
+        if (_field_won(field)) {
+            result = SOLVE_WON;
+            break;
+        }
+
+        struct solve_frame *frame = &solver->frames[depth];
+        if (frame->next == frame->cnt) {
+            if (depth == 0)
+                break;
+            undo_move(field);
+            depth--;
+            // A player who can not peek can not take back a reveal
+            if (solver->frames[depth].committed)
+                break;
+            continue;
+        }
+
+        struct card_move *move = &solver->moves[frame->start + frame->next++];
+        uint64_t seen = frame->seen;
+        bool reveals = _move_reveals(field, move, &seen);
+        frame->committed = reveals && !solver->opts.thoughtful;
+
+        frame->step.move = *move;
+        frame->step.card = 0;
+        if (move->dst != LOC_STOCK) {
+            struct pile *src_pile = field_pile(field, move->src);
+            int n = move->src == LOC_STOCK ? 0 : move->cnt - 1;
+            frame->step.card = (uint8_t)card_id(pile_get_nth_card(src_pile, n));
+        }
+
+        if (!field_apply_move(field, move)) {
+            assert(false);
+            continue;
+        }
+        solver->nodes++;
+
+        if ((solver->opts.max_nodes && solver->nodes >= solver->opts.max_nodes)
+            || (solver->opts.max_seconds > 0
+                && solver->nodes % SOLVER_CLOCK_INTERVAL == 0
+                && _now() - start >= solver->opts.max_seconds)) {
+            undo_move(field);
+            result = SOLVE_UNKNOWN;
+            break;
+        }
+
+        if (!_tt_insert(solver, field_hash(field))) {
+            undo_move(field);
+            if (frame->committed)
+                break;
+            continue;
+        }
+
+        depth++;
+        _solver_gen(solver, field, depth);
+        solver->frames[depth].seen = seen;
+    }
+
+    if (result == SOLVE_WON) {
+        solver->solution = realloc(
+            solver->solution,
+            sizeof(struct solve_step) * (size_t)(depth + 1)
+            );
+        if (solver->solution == NULL)
+            die("realloc");
+        int i;
+        for (i = 0; i < depth; ++i)
+            solver->solution[i] = solver->frames[i].step;
+        solver->solution_len = depth;
+    }
+
+    // Put the field back the way it was handed in
+    for (; depth > 0; --depth)
+        undo_move(field);
+
+    return result;
+}
+
+// EXTERNAL / PUBLIC FUNCTIONS
+
+void
+solver_opts_default(struct solver_opts *opts)
+{
+    opts->max_nodes = 0;
+    opts->max_seconds = 0;
+    opts->tt_bits = 20;
+    opts->thoughtful = false;
+}
+
+void
+solver_init(struct solver *solver, struct solver_opts *opts)
+{
+    memset(solver, 0, sizeof(struct solver));
+    if (opts != NULL)
+        solver->opts = *opts;
+    else
+        solver_opts_default(&solver->opts);
+
+    if (solver->opts.tt_bits < 4)
+        solver->opts.tt_bits = 4;
+    size_t entries = (size_t)1 << solver->opts.tt_bits;
+    solver->tt = calloc(entries, sizeof(uint64_t));
+    if (solver->tt == NULL)
+        die("calloc");
+    solver->tt_mask = entries - 1;
+
+    solver->frames_cap = 256;
+    solver->frames = malloc(
+        sizeof(struct solve_frame) * (size_t)solver->frames_cap);
+    solver->moves_cap = 4096;
+    solver->moves = malloc(
+        sizeof(struct card_move) * (size_t)solver->moves_cap);
+    if (solver->frames == NULL || solver->moves == NULL)
+        die("malloc");
+}
+
+void
+solver_destroy(struct solver *solver)
+{
+    free(solver->tt);
+    free(solver->moves);
+    free(solver->frames);
+    free(solver->solution);
+    memset(solver, 0, sizeof(struct solver));
+}
+
+enum solve_result
+solver_run(struct solver *solver, struct field *field)
+{
+    double start = _now();
+
+    solver->nodes = 0;
+    solver->solution_len = 0;
+    solver->exact = false;
+    enum solve_result result = _solver_search(solver, field, start);
+    // Skipping the moves that rarely help can lose a deal that could be won,
+    // so a search that sees every card proves a loss without skipping them
+    if (result == SOLVE_LOST && solver->opts.thoughtful) {
+        solver->exact = true;
+        result = _solver_search(solver, field, start);
+    }
+
+    solver->seconds = _now() - start;
+    return result;
+}
+
+int
+solve_step_str(struct solve_step *step, char *buf, size_t len)
+{
+    char name[3];
+
+    if (step->move.src == LOC_STOCK || step->move.dst == LOC_STOCK)
+        return snprintf(buf, len, "deal");
+
+    struct card card = {
+        .suit = (enum card_suit)(step->card / RANK_MAX),
+        .rank = (enum card_rank)(step->card % RANK_MAX),
+    };
+    card_str(&card, name);
+    if (step->move.dst >= LOC_FOUND0)
+        return snprintf(buf, len, "%s f%d", name,
+            step->move.dst - LOC_FOUND0 + 1);
+    return snprintf(buf, len, "%s t%d", name, step->move.dst - LOC_TAB0 + 1);
+}
+
+char const *
+solve_result_str(enum solve_result result)
+{
+    char const *strs[] = { "won", "lost", "unknown" };
+    if (result < SOLVE_WON || result > SOLVE_UNKNOWN)
+        return "invalid";
+    return strs[result];
+}
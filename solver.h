@@ -0,0 +1,110 @@
+#ifndef SOLITAIRE_SOLVER_H_
+#define SOLITAIRE_SOLVER_H_
+
+#include "card_type.h"
+#include <stddef.h>
+#include <stdint.h>
+
+enum solve_result {
+    SOLVE_WON,
+    SOLVE_LOST,
+    SOLVE_UNKNOWN,
+};
+
+struct solver_opts {
+    uint64_t max_nodes;     // 0 for no limit
+    double max_seconds;     // 0 for no limit
+    int tt_bits;            // log2 of the transposition table entries
+    bool thoughtful;        // Allow the search to see face down cards
+};
+
+// One move of a solution, along with the card it moved
+struct solve_step {
+    struct card_move move;
+    uint8_t card;
+};
+
+struct solve_frame {
+    struct solve_step step;
+    int start;
+    int cnt;
+    int next;
+    bool committed;
+    uint64_t seen;
+};
+
+struct solver {
+    struct solver_opts opts;
+    uint64_t *tt;
+    uint64_t tt_mask;
+    uint64_t tt_gen;
+    struct card_move *moves;
+    int moves_cap;
+    struct solve_frame *frames;
+    int frames_cap;
+    struct solve_step *solution;
+    int solution_len;
+    uint64_t nodes;
+    double seconds;
+    bool exact;             // Try the moves the search usually skips
+};
+
+/**
+ * solver_opts_default - Fill in the default solver options.
+ * @opts: struct solver_opts * to fill in
+ */
+void
+solver_opts_default(struct solver_opts *opts);
+
+/**
+ * solver_init - Allocate a solver.
+ * @solver: struct solver * to set up
+ * @opts: struct solver_opts * to copy, or NULL for the defaults
+ *
+ * A solver holds no global state, so one solver per thread is safe.
+ */
+void
+solver_init(struct solver *solver, struct solver_opts *opts);
+
+void
+solver_destroy(struct solver *solver);
+
+/**
+ * solver_run - Decide whether a position can be won.
+ * @solver: struct solver * set up by solver_init
+ * @field: struct field * to solve, restored to its starting state on return
+ *
+ * Runs a depth first search over field_gen_moves, playing moves with
+ * field_apply_move and taking them back with undo_move. Positions are keyed
+ * by field_hash in the transposition table.
+ *
+ * The search skips moves that rarely help: splitting a face up run without
+ * freeing a card for a foundation, and moving a whole tableau to an empty one.
+ * Without opts.thoughtful it also may not take back a move that revealed a
+ * card it had not seen, so SOLVE_LOST means a player who can not peek at face
+ * down cards lost the deal with this strategy. With opts.thoughtful a loss is
+ * searched again with every move, so SOLVE_LOST means no play wins the deal.
+ * SOLVE_UNKNOWN is returned when a node or time limit is hit, counting the
+ * nodes of both searches.
+ *
+ * On SOLVE_WON the moves are in solver->solution.
+ */
+enum solve_result
+solver_run(struct solver *solver, struct field *field);
+
+/**
+ * solve_step_str - Write a step in the notation user_input accepts.
+ * @step: struct solve_step * to write
+ * @buf: char * to write to
+ * @len: size of buf
+ *
+ * Writes "deal" for deals and recycles and "<card> <pile>" otherwise, such as
+ * "as f1" or "kh t3". Returns the snprintf result.
+ */
+int
+solve_step_str(struct solve_step *step, char *buf, size_t len);
+
+char const *
+solve_result_str(enum solve_result result);
+
+#endif // SOLITAIRE_SOLVER_H_
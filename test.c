@@ -1,6 +1,15 @@
 #include "test.h"
 #include "debug.h"
+#include "solver.h"
+#include "arena.h"
+#include "batch.h"
+#include "deal.h"
+#include "sim.h"
+#include "render.h"
+#include "server.h"
+#include "load.h"
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 
 typedef bool (*FieldTestFunc)(struct field *field);
@@ -79,6 +88,54 @@ test3(struct field *field)
     return true;
 }
 
+static inline bool
+_pile_indexing_is_consistent(struct pile *pile)
+{
+    int n;
+    for (n = 0; n < pile_count(pile); ++n) {
+        struct card *card = pile_get_nth_card(pile, n);
+        if (card->pile != pile)
+            return false;
+        if (n == 0 && card != pile_top_card(pile))
+            return false;
+        if (n == pile_count(pile) - 1 && card != pile_last_card(pile))
+            return false;
+        if (n > 0 && card_prev(card) != pile_get_nth_card(pile, n - 1))
+            return false;
+    }
+    return pile_get_nth_card(pile, n) == NULL;
+}
+
+bool
+piles_hold_every_card_once(struct field *field)
+{
+    PFUNC;
+    int i;
+    for (i = 0; i < 40; ++i)
+        deal_card(field);
+
+    struct pile *piles[] = {
+        &field->stock, &field->waste,
+        &field->tableaus[0], &field->tableaus[1], &field->tableaus[2],
+        &field->tableaus[3], &field->tableaus[4], &field->tableaus[5],
+        &field->tableaus[6], &field->foundations[0], &field->foundations[1],
+        &field->foundations[2], &field->foundations[3],
+    };
+
+    int total = 0;
+    for (i = 0; i < 13; ++i) {
+        if (!_pile_indexing_is_consistent(piles[i]))
+            return false;
+        total += pile_count(piles[i]);
+    }
+
+    for (i = 0; i < NUM_TABLEAU; ++i)
+        if (pile_count(&field->tableaus[i]) != i + 1)
+            return false;
+
+    return total == SOLITAIRE_DECK_SIZE;
+}
+
 /*
 static inline bool
 _test_move_pile(
@@ -98,16 +155,1053 @@ _test_move_pile(
 }
 */
 
+bool
+pack_unpack_round_trips(struct field *field)
+{
+    PFUNC;
+    int i;
+    for (i = 0; i < 10; ++i)
+        deal_card(field);
+
+    struct field_pack pack;
+    struct field_pack repack;
+    field_pack(field, &pack);
+
+    struct deck deck = { 0 };
+    struct field copy;
+    deck_init(&deck);
+    if (!field_unpack(&copy, &deck, &pack))
+        return false;
+    field_pack(&copy, &repack);
+
+    bool same = memcmp(&pack, &repack, sizeof(pack)) == 0;
+    for (i = 0; i < NUM_TABLEAU; ++i)
+        if (card_id(pile_top_card(&copy.tableaus[i]))
+            != card_id(pile_top_card(&field->tableaus[i])))
+            same = false;
+
+    // A card listed twice must be rejected
+    pack.cards[1] = pack.cards[0];
+    if (field_unpack(&copy, &deck, &pack))
+        same = false;
+
+    field_destroy(&copy);
+    deck_destroy(&deck);
+    return same;
+}
+bool
+hash_tracks_deals_and_undos(struct field *field)
+{
+    PFUNC;
+    uint64_t start = field_hash(field);
+    if (start != field_hash_compute(field))
+        return false;
+
+    int i;
+    for (i = 0; i < 60; ++i) {
+        deal_card(field);
+        if (field_hash(field) != field_hash_compute(field))
+            return false;
+    }
+
+    for (i = 0; i < 60; ++i) {
+        undo_move(field);
+        if (field_hash(field) != field_hash_compute(field))
+            return false;
+    }
+
+    return field_hash(field) == start;
+}
+// A recycle leaves the cards to be restamped as they are reached, so they must
+// be found in the stock face down, and undoing it must give the waste back
+bool
+recycle_restamps_lazily(struct field *field)
+{
+    PFUNC;
+    struct field_pack before;
+    struct field_pack pack;
+    int len = pile_count(&field->stock) + pile_count(&field->waste);
+
+    while (!pile_empty(&field->stock))
+        deal_card(field);
+    field_pack(field, &before);
+    deal_card(field);
+
+    int suit;
+    int rank;
+    int found = 0;
+    for (suit = SUIT_SPADE; suit < SUIT_MAX; ++suit) {
+        for (rank = RANK_A; rank < RANK_MAX; ++rank) {
+            struct card *card = field_search(field, suit, rank);
+            if (card->location == LOC_WASTE)
+                return false;
+            if (card->location != LOC_STOCK)
+                continue;
+            if (card->pile != &field->stock || card->face_up)
+                return false;
+            if (pile_get_nth_card(&field->stock, len - 1 - card->pos) != card)
+                return false;
+            found++;
+        }
+    }
+    if (found != len || field_hash(field) != field_hash_compute(field))
+        return false;
+
+    undo_move(field);
+    field_pack(field, &pack);
+    if (memcmp(&pack, &before, sizeof(pack)) != 0)
+        return false;
+    return field_hash(field) == field_hash_compute(field);
+}
+
+// Plays generated moves for a while, checking that every one is accepted.
+bool
+generated_moves_apply(struct field *field)
+{
+    PFUNC;
+    struct card_move moves[FIELD_MAX_MOVES];
+    int i;
+    for (i = 0; i < 200; ++i) {
+        int cnt = field_gen_moves(field, moves, FIELD_MAX_MOVES);
+        if (cnt > FIELD_MAX_MOVES)
+            return false;
+        if (cnt == 0)
+            break;
+
+        // Spread the picks over the list rather than always dealing
+        struct card_move *move = &moves[(i * 7) % cnt];
+        if (!field_apply_move(field, move))
+            return false;
+        if (field_hash(field) != field_hash_compute(field))
+            return false;
+    }
+
+    // The buffer size limits what is written, not what is counted
+    int all = field_gen_moves(field, moves, FIELD_MAX_MOVES);
+    return field_gen_moves(field, moves, 0) == all;
+}
+
+// The rules written out from scratch, to hold the move tables against
+static inline bool
+_rule_tableau(struct card *src, struct card *dst)
+{
+    if (dst == NULL)
+        return src->rank == RANK_K;
+    return src->color != dst->color && src->rank + 1 == dst->rank;
+}
+
+static inline bool
+_rule_foundation(struct card *src, struct card *dst)
+{
+    if (dst == NULL)
+        return src->rank == RANK_A;
+    return src->suit == dst->suit && src->rank == dst->rank + 1;
+}
+
+static inline int
+_rule_to_tableaus(struct field *field, struct card *src, struct pile *skip)
+{
+    int cnt = 0;
+    int i;
+    for (i = 0; i < NUM_TABLEAU; ++i)
+        if (&field->tableaus[i] != skip
+            && _rule_tableau(src, pile_top_card(&field->tableaus[i])))
+            cnt++;
+    return cnt;
+}
+
+static inline int
+_rule_to_foundations(struct field *field, struct card *src)
+{
+    int i;
+    for (i = 0; i < NUM_FOUNDATION; ++i)
+        if (_rule_foundation(src, pile_top_card(&field->foundations[i])))
+            return 1;
+    return 0;
+}
+
+// Every generated move must follow the rules and no move may be missed
+bool
+generated_moves_follow_rules(struct field *field)
+{
+    PFUNC;
+    struct card_move moves[FIELD_MAX_MOVES];
+    int i;
+    int j;
+    int k;
+    for (i = 0; i < 300; ++i) {
+        int cnt = field_gen_moves(field, moves, FIELD_MAX_MOVES);
+        if (cnt == 0)
+            break;
+
+        int expect = 0;
+        struct card *card = pile_top_card(&field->waste);
+        if (card != NULL)
+            expect += _rule_to_tableaus(field, card, NULL)
+                + _rule_to_foundations(field, card);
+        for (j = 0; j < NUM_TABLEAU; ++j) {
+            struct pile *pile = &field->tableaus[j];
+            if (pile_top_is_face_up(pile))
+                expect += _rule_to_foundations(field, pile_top_card(pile));
+            for (k = 0; k < pile_count(pile); ++k) {
+                card = pile_get_nth_card(pile, k);
+                if (!card->face_up)
+                    break;
+                expect += _rule_to_tableaus(field, card, pile);
+            }
+        }
+        for (j = 0; j < NUM_FOUNDATION; ++j)
+            if ((card = pile_top_card(&field->foundations[j])) != NULL)
+                expect += _rule_to_tableaus(field, card, NULL);
+
+        int got = 0;
+        for (j = 0; j < cnt; ++j) {
+            struct card_move *move = &moves[j];
+            if (move->src == LOC_STOCK || move->dst == LOC_STOCK)
+                continue;
+            struct pile *src = field_pile(field, move->src);
+            struct pile *dst = field_pile(field, move->dst);
+            card = pile_get_nth_card(src, move->cnt - 1);
+            bool ok = move->dst >= LOC_FOUND0
+                ? _rule_foundation(card, pile_top_card(dst))
+                : _rule_tableau(card, pile_top_card(dst));
+            if (!ok)
+                return false;
+            got++;
+        }
+        if (got != expect)
+            return false;
+        field_apply_move(field, &moves[(i * 13) % cnt]);
+    }
+    return true;
+}
+
+// Every reason a move can be refused, each from a position built to hit it,
+// leaving the field as it was
+bool
+quiet_moves_report_reasons(struct field *field)
+{
+    PFUNC;
+    // The cards outside the stock, pile by pile and bottom to top. What the
+    // stock has no room for goes face down under the last tableau.
+    struct {
+        enum card_location loc;
+        enum card_suit suit;
+        enum card_rank rank;
+        bool face_up;
+    } const laid[] = {
+        { LOC_WASTE, SUIT_SPADE, RANK_5, true },
+        { LOC_WASTE, SUIT_DIAMOND, RANK_9, true },
+        { LOC_TAB1, SUIT_CLUB, RANK_3, false },
+        { LOC_TAB1, SUIT_SPADE, RANK_8, true },
+        { LOC_TAB1, SUIT_DIAMOND, RANK_7, true },
+        { LOC_TAB2, SUIT_HEART, RANK_8, true },
+        { LOC_TAB3, SUIT_CLUB, RANK_5, true },
+        { LOC_TAB4, SUIT_DIAMOND, RANK_2, true },
+        { LOC_TAB5, SUIT_SPADE, RANK_3, true },
+        { LOC_FOUND0, SUIT_SPADE, RANK_A, true },
+    };
+    int const num_laid = sizeof(laid) / sizeof(laid[0]);
+    bool used[SOLITAIRE_DECK_SIZE] = { 0 };
+    struct field_pack pack = { 0 };
+    int n = 0;
+    int i;
+
+    for (i = 0; i < num_laid; ++i)
+        used[laid[i].suit * RANK_MAX + laid[i].rank] = true;
+    int id = 0;
+    int loc;
+    for (loc = LOC_STOCK; loc <= LOC_FOUND3; ++loc) {
+        int first = n;
+        for (i = 0; i < num_laid; ++i) {
+            if (laid[i].loc != loc)
+                continue;
+            pack.cards[n++] = (uint8_t)(laid[i].suit * RANK_MAX + laid[i].rank)
+                | (laid[i].face_up ? FIELD_PACK_FACE_UP : 0);
+        }
+        int room = loc == LOC_STOCK ? STOCK_CAP
+            : loc == LOC_TAB6 ? SOLITAIRE_DECK_SIZE : 0;
+        for (; id < SOLITAIRE_DECK_SIZE && n - first < room; ++id)
+            if (!used[id])
+                pack.cards[n++] = (uint8_t)id;
+        if (loc < LOC_FOUND3)
+            pack.lens[loc - LOC_STOCK] = (uint8_t)(n - first);
+    }
+
+    struct deck deck = { 0 };
+    struct field f;
+    deck_init_seeded(&deck, 3);
+    if (!field_unpack(&f, &deck, &pack))
+        return false;
+    uint64_t hash = field_hash(&f);
+
+    struct card *nine = field_search(&f, SUIT_DIAMOND, RANK_9);
+    struct card *five = field_search(&f, SUIT_SPADE, RANK_5);
+    struct card *hidden = field_search(&f, SUIT_CLUB, RANK_3);
+    struct card *seven = field_search(&f, SUIT_DIAMOND, RANK_7);
+    struct card *two = field_search(&f, SUIT_DIAMOND, RANK_2);
+    struct card *three = field_search(&f, SUIT_SPADE, RANK_3);
+    struct card *eight = field_search(&f, SUIT_SPADE, RANK_8);
+    struct pile *tab = f.tableaus;
+    struct pile *found = f.foundations;
+
+    struct {
+        enum move_status got;
+        enum move_status want;
+    } const checks[] = {
+        { move_card_to_pile_quiet(NULL, &tab[0]), MOVE_ERR_NO_CARD },
+        { move_card_to_pile_quiet(hidden, &tab[0]), MOVE_ERR_NOT_FACE_UP },
+        { move_card_to_card_quiet(nine, hidden), MOVE_ERR_DST_NOT_FACE_UP },
+        { move_card_to_pile_quiet(seven, &f.stock), MOVE_ERR_DST_PILE },
+        { move_card_to_card_quiet(seven, seven), MOVE_ERR_SAME_CARD },
+        { move_card_to_pile_quiet(five, &found[1]), MOVE_ERR_NOT_TOP },
+        { move_card_to_pile_quiet(seven, &tab[0]), MOVE_ERR_NOT_KING },
+        { move_card_to_pile_quiet(nine, &found[1]), MOVE_ERR_NOT_ACE },
+        { move_card_to_pile_quiet(seven, &tab[2]), MOVE_ERR_COLOR },
+        { move_card_to_pile_quiet(nine, &tab[3]), MOVE_ERR_RANK },
+        { move_card_to_card_quiet(nine, eight), MOVE_ERR_RANK },
+        { move_card_to_pile_quiet(two, &found[0]), MOVE_ERR_SUIT },
+        { move_card_to_pile_quiet(three, &found[0]), MOVE_ERR_RANK },
+    };
+    bool ok = true;
+    for (i = 0; i < (int)(sizeof(checks) / sizeof(checks[0])); ++i)
+        ok = ok && checks[i].got == checks[i].want;
+    ok = ok && field_hash(&f) == hash && field_hash_compute(&f) == hash;
+
+    // Stock cards are never face up, so no deal reaches the source check;
+    // turn one over by hand to get past the face up check
+    struct card *stocked = pile_top_card(&f.stock);
+    stocked->face_up = true;
+    ok = ok && move_card_to_pile_quiet(stocked, &tab[0]) == MOVE_ERR_SRC_PILE;
+    stocked->face_up = false;
+    ok = ok && field_hash(&f) == hash && field_hash_compute(&f) == hash;
+
+    field_destroy(&f);
+    deck_destroy(&deck);
+    return ok;
+}
+bool
+field_search_finds_every_card(struct field *field)
+{
+    PFUNC;
+    int suit;
+    int rank;
+    for (suit = SUIT_SPADE; suit < SUIT_MAX; ++suit) {
+        for (rank = RANK_A; rank < RANK_MAX; ++rank) {
+            struct card *card = field_search(field, suit, rank);
+            if (card == NULL || card->suit != suit || card->rank != rank)
+                return false;
+            if (!pile_has_card(card->pile, card))
+                return false;
+            if (pile_search(card->pile, suit, rank) != card)
+                return false;
+            if (pile_has_card(&field->foundations[0], card))
+                return false;
+        }
+    }
+    return field_search(field, SUIT_MAX, RANK_A) == NULL;
+}
+// Any solution the solver finds must replay to a won game, and the solver must
+// hand the field back untouched.
+bool
+solver_solution_replays(struct field *field)
+{
+    PFUNC;
+    struct solver_opts opts;
+    solver_opts_default(&opts);
+    opts.thoughtful = true;
+    opts.max_nodes = 200000;
+
+    struct solver solver;
+    solver_init(&solver, &opts);
+    uint64_t hash = field_hash(field);
+    enum solve_result result = solver_run(&solver, field);
+    bool ok = field_hash(field) == hash && field_hash_compute(field) == hash;
+
+    int i;
+    for (i = 0; ok && i < solver.solution_len; ++i)
+        ok = field_apply_move(field, &solver.solution[i].move);
+    if (result == SOLVE_WON)
+        ok = ok && game_completion_check(field);
+
+    solver_destroy(&solver);
+    return ok;
+}
+// Solutions written out as commands replay through field_command, and bad
+// commands leave the field alone
+bool
+solution_commands_replay(struct field *field)
+{
+    PFUNC;
+    struct solver_opts opts;
+    solver_opts_default(&opts);
+    opts.thoughtful = true;
+    opts.max_nodes = 200000;
+
+    char bad[][16] = { "as", "zz t1", "as t9", " t1", "as " };
+    uint64_t hash = field_hash(field);
+    size_t i;
+    for (i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i)
+        if (field_command(field, bad[i], true))
+            return false;
+    if (field_hash(field) != hash)
+        return false;
+
+    // Undo is refused once every move, the opening deal included, is taken
+    // back
+    char undo[] = "undo";
+    while (field->history.cnt > 0)
+        if (!field_command(field, undo, true))
+            return false;
+    if (field_command(field, undo, true))
+        return false;
+
+    struct solver solver;
+    solver_init(&solver, &opts);
+    // Replays the first deal of a few the solver wins
+    bool solved = false;
+    bool won = false;
+    uint64_t seed;
+    for (seed = 1; !solved && seed < 10; ++seed) {
+        struct deck deck = { 0 };
+        struct field game;
+        deck_init_seeded(&deck, seed);
+        field_init(&game, &deck);
+        solved = solver_run(&solver, &game) == SOLVE_WON;
+        if (solved) {
+            bool ok = true;
+            char cmd[16];
+            int j;
+            for (j = 0; ok && j < solver.solution_len; ++j) {
+                solve_step_str(&solver.solution[j], cmd, sizeof(cmd));
+                ok = field_command(&game, cmd, true);
+            }
+            won = ok && game_completion_check(&game);
+        }
+        field_destroy(&game);
+        deck_destroy(&deck);
+    }
+    solver_destroy(&solver);
+    return won;
+}
+
+bool
+seeded_decks_repeat(struct field *field)
+{
+    PFUNC;
+    struct deck decks[3] = { 0 };
+    struct field fields[3];
+    struct field_pack packs[3];
+    uint64_t seeds[3] = { 42, 42, 43 };
+    int i;
+    for (i = 0; i < 3; ++i) {
+        deck_init_seeded(&decks[i], seeds[i]);
+        field_init(&fields[i], &decks[i]);
+        field_pack(&fields[i], &packs[i]);
+        field_destroy(&fields[i]);
+        deck_destroy(&decks[i]);
+    }
+    return memcmp(&packs[0], &packs[1], sizeof(packs[0])) == 0
+        && memcmp(&packs[0], &packs[2], sizeof(packs[0])) != 0;
+}
+
+// Deal numbers must name the same deal on every build and platform, so pin
+// the whole deck order of one deal
+bool
+deal_numbers_are_stable(struct field *field)
+{
+    PFUNC;
+    static uint8_t const deal_one[SOLITAIRE_DECK_SIZE] = {
+        9, 25, 34, 48, 20, 31, 30, 51, 13, 16, 24, 47, 46, 43, 12, 45, 4,
+        27, 7, 8, 42, 0, 40, 29, 21, 49, 5, 11, 10, 18, 15, 14, 35, 1, 44,
+        2, 32, 22, 50, 37, 41, 39, 23, 38, 17, 3, 6, 33, 19, 28, 26, 36,
+    };
+    struct deck deck = { 0 };
+    bool ret = true;
+    int i;
+    deck_init_seeded(&deck, 1);
+    ret &= deck.seed == 1;
+    for (i = 0; i < SOLITAIRE_DECK_SIZE; ++i)
+        ret &= card_id(&deck.cards[i]) == deal_one[i];
+    deck_destroy(&deck);
+    return ret;
+}
+
+// Every bulk deal must be the deck deck_init_seeded deals for the same number
+bool
+bulk_deals_match_decks(struct field *field)
+{
+    PFUNC;
+    enum { CNT = 11 };
+    uint8_t perms[CNT][SOLITAIRE_DECK_SIZE];
+    bool ret = true;
+    int i;
+    int j;
+    deal_gen_bulk(&perms[0][0], 1000, CNT);
+    for (i = 0; i < CNT; ++i) {
+        struct deck deck = { 0 };
+        deck_init_seeded(&deck, 1000 + (uint64_t)i);
+        for (j = 0; j < SOLITAIRE_DECK_SIZE; ++j)
+            ret &= card_id(&deck.cards[j]) == perms[i][j];
+        deck_destroy(&deck);
+    }
+    return ret;
+}
+
+// Simulations must repeat exactly, and their intervals must hold the win rate
+bool
+simulation_repeats(struct field *field)
+{
+    PFUNC;
+    struct sim_opts opts;
+    struct sim_stats stats[2];
+    double lo;
+    double hi;
+    bool ret = true;
+    int i;
+    sim_opts_default(&opts);
+    opts.first = 200;
+    opts.games = 20;
+    for (i = 0; i < 2; ++i)
+        sim_run(&opts, &stats[i]);
+    ret &= stats[0].games == 20;
+    ret &= stats[0].won == stats[1].won && stats[0].moves == stats[1].moves;
+    sim_wilson(stats[0].won, stats[0].games, 1.96, &lo, &hi);
+    ret &= lo <= (double)stats[0].won / 20 && (double)stats[0].won / 20 <= hi;
+    sim_wilson(0, 100, 1.96, &lo, &hi);
+    ret &= lo == 0 && hi > 0 && hi < 0.05;
+    return ret;
+}
+
+// A reset field must be the field a fresh deck and field_init would give, in
+// the same storage, whether that storage is on the heap or in an arena
+bool
+reset_fields_match_fresh(struct field *field)
+{
+    PFUNC;
+    struct arena arena;
+    struct deck decks[2] = { 0 };
+    struct field fields[2];
+    struct field_pack packs[2];
+    bool ret = true;
+    int i;
+    int j;
+
+    arena_init(&arena, 0);
+    deck_init_seeded(&decks[0], 1);
+    field_init(&fields[0], &decks[0]);
+    deck_init_arena(&decks[1], 1, &arena);
+    field_init_arena(&fields[1], &decks[1], &arena);
+    for (i = 0; i < 2; ++i) {
+        struct card *cards = decks[i].cards;
+        // Grow the history past its first block before starting over
+        for (j = 0; j < 100; ++j)
+            deal_card(&fields[i]);
+        field_reset(&fields[i], 2);
+        ret &= decks[i].cards == cards;
+    }
+
+    struct deck deck = { 0 };
+    struct field fresh;
+    struct field_pack pack;
+    deck_init_seeded(&deck, 2);
+    field_init(&fresh, &deck);
+    field_pack(&fresh, &pack);
+    for (i = 0; i < 2; ++i) {
+        field_pack(&fields[i], &packs[i]);
+        ret &= memcmp(&pack, &packs[i], sizeof(pack)) == 0;
+        ret &= field_hash(&fields[i]) == field_hash(&fresh);
+        ret &= field_hash(&fields[i]) == field_hash_compute(&fields[i]);
+        ret &= fields[i].history.cnt == fresh.history.cnt;
+    }
+
+    // An arena that was reset hands out the same memory again
+    void *first = arena.head->data;
+    arena_reset(&arena);
+    ret &= arena_alloc(&arena, 8) == first;
+
+    field_destroy(&fresh);
+    deck_destroy(&deck);
+    for (i = 0; i < 2; ++i) {
+        field_destroy(&fields[i]);
+        deck_destroy(&decks[i]);
+    }
+    arena_destroy(&arena);
+    return ret;
+}
+
+// Undo must take a game all the way back, and so must a copy of its history
+// in another field holding the same position
+bool
+history_copies_undo_exactly(struct field *field)
+{
+    PFUNC;
+    struct card_move moves[FIELD_MAX_MOVES];
+    struct deck decks[2] = { 0 };
+    struct field fields[2];
+    struct field_pack start;
+    struct field_pack pack;
+    bool ret = true;
+    int i;
+
+    deck_init_seeded(&decks[0], 3);
+    field_init(&fields[0], &decks[0]);
+    field_pack(&fields[0], &start);
+    for (i = 0; i < 300; ++i) {
+        int cnt = field_gen_moves(&fields[0], moves, FIELD_MAX_MOVES);
+        if (cnt == 0)
+            break;
+        field_apply_move(&fields[0], &moves[(i * 7) % cnt]);
+    }
+
+    deck_init_seeded(&decks[1], 3);
+    field_pack(&fields[0], &pack);
+    ret &= field_unpack(&fields[1], &decks[1], &pack);
+    field_history_copy(&fields[1], &fields[0]);
+    for (i = 0; i < 2; ++i) {
+        while (fields[i].history.cnt > 1)
+            undo_move(&fields[i]);
+        field_pack(&fields[i], &pack);
+        ret &= memcmp(&pack, &start, sizeof(pack)) == 0;
+        ret &= field_hash(&fields[i]) == field_hash_compute(&fields[i]);
+        field_destroy(&fields[i]);
+        deck_destroy(&decks[i]);
+    }
+    return ret;
+}
+
+// The dead end check kept up move by move must agree with one worked out from
+// scratch on a copy of the position
+bool
+dead_end_tracks_moves(struct field *field)
+{
+    PFUNC;
+    struct card_move moves[FIELD_MAX_MOVES];
+    struct deck deck = { 0 };
+    struct field copy;
+    struct field_pack pack;
+    bool ret = true;
+    int i;
+
+    deck_init_seeded(&deck, 5);
+    for (i = 0; i < 400 && ret; ++i) {
+        field_pack(field, &pack);
+        ret &= field_unpack(&copy, &deck, &pack);
+        ret &= dead_end_check(field) == dead_end_check(&copy);
+        field_destroy(&copy);
+
+        int cnt = field_gen_moves(field, moves, FIELD_MAX_MOVES);
+        if (cnt == 0)
+            break;
+        if (i % 5 == 4)
+            undo_move(field);
+        else
+            field_apply_move(field, &moves[(i * 11) % cnt]);
+    }
+    deck_destroy(&deck);
+    return ret;
+}
+
+// With the spades up to the nine on a foundation, the ten of spades in the
+// waste is the only move left. Playing it leaves a dead end and undoing it
+// takes that back.
+bool
+waste_to_foundation_is_not_dead_end(struct field *field)
+{
+    PFUNC;
+    struct card_move move = { LOC_WASTE, LOC_FOUND0, 1 };
+    struct field_pack pack = { 0 };
+    struct deck deck = { 0 };
+    struct field f;
+    int n = 0;
+    int suit;
+    int rank;
+
+    pack.lens[LOC_WASTE - LOC_STOCK] = 1;
+    pack.cards[n++] = (SUIT_SPADE * RANK_MAX + RANK_10) | FIELD_PACK_FACE_UP;
+    pack.lens[LOC_TAB0 - LOC_STOCK] = 3;
+    for (rank = RANK_K; rank > RANK_10; --rank)
+        pack.cards[n++] = SUIT_SPADE * RANK_MAX + rank;
+    pack.lens[LOC_FOUND0 - LOC_STOCK] = 9;
+    for (suit = SUIT_SPADE; suit < SUIT_MAX; ++suit) {
+        if (suit > SUIT_SPADE && suit < SUIT_HEART)
+            pack.lens[LOC_FOUND0 + suit - LOC_STOCK] = RANK_MAX;
+        for (rank = RANK_A; rank < RANK_MAX; ++rank)
+            if (suit != SUIT_SPADE || rank < RANK_10)
+                pack.cards[n++] = (uint8_t)(suit * RANK_MAX + rank)
+                    | FIELD_PACK_FACE_UP;
+    }
+
+    deck_init_seeded(&deck, 1);
+    bool ret = field_unpack(&f, &deck, &pack);
+    ret = ret && !dead_end_check(&f);
+    if (ret)
+        field_apply_move(&f, &move);
+    ret = ret && pile_count(&f.foundations[0]) == 10;
+    ret = ret && dead_end_check(&f);
+    if (ret)
+        undo_move(&f);
+    ret = ret && !dead_end_check(&f);
+    field_destroy(&f);
+    deck_destroy(&deck);
+    return ret;
+}
+
+// The ten of spades tops a run on a face down card, with the spades up to the
+// nine on a foundation. Every card the foundations want next lies face down
+// under the diamonds from the king down to the six, which with in_stock is
+// left alone in the stock instead.
+static inline void
+_run_top_pack(struct field_pack *pack, bool in_stock)
+{
+    int found_lens[SUIT_MAX] = { RANK_10, RANK_5, RANK_MAX, RANK_10 };
+    int low = in_stock ? RANK_6 : RANK_5;
+    int n = 0;
+    int suit;
+    int rank;
+
+    memset(pack, 0, sizeof(struct field_pack));
+    if (in_stock) {
+        pack->lens[LOC_STOCK - LOC_STOCK] = 1;
+        pack->cards[n++] = SUIT_DIAMOND * RANK_MAX + RANK_6;
+    }
+    pack->lens[LOC_TAB0 - LOC_STOCK] = 3;
+    pack->cards[n++] = SUIT_DIAMOND * RANK_MAX + RANK_5;
+    pack->cards[n++] = (SUIT_HEART * RANK_MAX + RANK_J) | FIELD_PACK_FACE_UP;
+    pack->cards[n++] = (SUIT_SPADE * RANK_MAX + RANK_10) | FIELD_PACK_FACE_UP;
+    pack->lens[LOC_TAB1 - LOC_STOCK] = (uint8_t)(6 + RANK_K - low);
+    for (rank = RANK_K; rank > RANK_10; --rank) {
+        pack->cards[n++] = SUIT_SPADE * RANK_MAX + rank;
+        if (rank != RANK_J)
+            pack->cards[n++] = SUIT_HEART * RANK_MAX + rank;
+    }
+    pack->cards[n++] = SUIT_HEART * RANK_MAX + RANK_10;
+    for (rank = RANK_K; rank > low; --rank)
+        pack->cards[n++] = SUIT_DIAMOND * RANK_MAX + rank;
+    // The last foundation takes the rest, the hearts up to the nine
+    for (suit = SUIT_SPADE; suit < SUIT_MAX; ++suit) {
+        if (suit < SUIT_HEART)
+            pack->lens[LOC_FOUND0 + suit - LOC_STOCK] = found_lens[suit];
+        for (rank = RANK_A; rank < found_lens[suit]; ++rank)
+            pack->cards[n++] = (uint8_t)(suit * RANK_MAX + rank)
+                | FIELD_PACK_FACE_UP;
+    }
+}
+
+// Moving the whole run goes nowhere, but the ten of spades on top of it can
+// still go home, so that is not a dead end until it has
+bool
+run_top_to_foundation_is_not_dead_end(struct field *field)
+{
+    PFUNC;
+    struct card_move move = { LOC_TAB0, LOC_FOUND0, 1 };
+    struct field_pack pack;
+    struct deck deck = { 0 };
+    struct field f;
+
+    _run_top_pack(&pack, false);
+    deck_init_seeded(&deck, 1);
+    bool ret = field_unpack(&f, &deck, &pack);
+    ret = ret && !dead_end_check(&f);
+    if (ret)
+        field_apply_move(&f, &move);
+    ret = ret && pile_count(&f.foundations[0]) == 10;
+    ret = ret && dead_end_check(&f);
+    if (ret)
+        undo_move(&f);
+    ret = ret && !dead_end_check(&f);
+    field_destroy(&f);
+    deck_destroy(&deck);
+    return ret;
+}
+
+// Solving a range on several threads must give what solving it in order does
+bool
+batch_matches_sequential(struct field *field)
+{
+    PFUNC;
+    struct batch_opts opts = { 0 };
+    struct batch_result results[12];
+    opts.first = 100;
+    opts.last = 111;
+    opts.threads = 3;
+    solver_opts_default(&opts.solver);
+    opts.solver.thoughtful = true;
+    opts.solver.max_nodes = 5000;
+    if (batch_run(&opts, results) != 0)
+        return false;
+
+    struct solver solver;
+    solver_init(&solver, &opts.solver);
+    bool ok = true;
+    int i;
+    for (i = 0; i < 12; ++i) {
+        struct deck deck = { 0 };
+        struct field seq;
+        deck_init_seeded(&deck, opts.first + (uint64_t)i);
+        field_init(&seq, &deck);
+        enum solve_result result = solver_run(&solver, &seq);
+        if (results[i].seed != opts.first + (uint64_t)i
+            || results[i].result != result
+            || results[i].nodes != solver.nodes)
+            ok = false;
+        field_destroy(&seq);
+        deck_destroy(&deck);
+    }
+    solver_destroy(&solver);
+    return ok;
+}
+
+// A fresh deal shows one line per tableau row and an XX for every hidden
+// card, every empty foundation and the stock
+bool
+render_frame_shows_deal(struct field *field)
+{
+    PFUNC;
+    struct render render;
+    render_frame(&render, field);
+    if (render.len >= RENDER_FRAME_MAX)
+        return false;
+    render.buf[render.len] = '\0';
+
+    int lines = 0;
+    int hidden = 0;
+    size_t i;
+    for (i = 0; i < render.len; ++i) {
+        if (render.buf[i] == '\n')
+            ++lines;
+        if (render.buf[i] == 'X' && render.buf[i + 1] == 'X')
+            ++hidden, ++i;
+    }
+    return strncmp(render.buf, "stock/waste: XX", 15) == 0
+        && lines == 3 + NUM_TABLEAU
+        && hidden == 1 + NUM_FOUNDATION + 21;
+}
+
+// After a move the screen only sends what changed, and ends up where a screen
+// drawn from scratch would be
+bool
+render_screen_diffs_moves(struct field *field)
+{
+    PFUNC;
+    struct render_screen screen;
+    struct render_screen fresh;
+    render_screen_init(&screen);
+    render_screen_init(&fresh);
+
+    size_t full = render_screen_diff(&screen, field);
+    if (full == 0 || render_screen_diff(&screen, field) != 0)
+        return false;
+
+    deal_card(field);
+    size_t diff = render_screen_diff(&screen, field);
+    render_screen_diff(&fresh, field);
+    return diff > 0 && diff < full / 4
+        && memcmp(screen.cells, fresh.cells, sizeof(screen.cells)) == 0;
+}
+
+// The server protocol plays a deal as field_command does, answering every
+// request, good or bad, with one line
+bool
+server_requests_play(struct field *field)
+{
+    PFUNC;
+    struct server_game game = { 0 };
+    char resp[SERVER_LINE_MAX];
+    char req[32];
+    bool ok = true;
+    size_t i;
+
+    strcpy(req, "show");
+    server_request(&game, req, resp);
+    ok = ok && strcmp(resp, "err no game\n") == 0;
+    strcpy(req, "new 3");
+    server_request(&game, req, resp);
+    ok = ok && strcmp(resp, "ok 3\n") == 0;
+
+    // A fresh deal shows the stock, the waste, empty foundations, and i face
+    // down cards under one face up card on tableau i
+    strcpy(req, "show");
+    size_t len = server_request(&game, req, resp);
+    ok = ok && len == strlen(resp) && resp[len - 1] == '\n'
+        && strncmp(resp, "ok 23 ", 6) == 0;
+    char *tab = strstr(resp, " -- -- -- -- ");
+    ok = ok && tab != NULL;
+    for (i = 0; ok && i < NUM_TABLEAU; ++i) {
+        tab = strchr(tab + 1, ' ');
+        if (i == 0)
+            tab += 9;
+        ok = tab[1] == (char)('0' + i) && tab[4] <= ' ';
+    }
+
+    char bad[][16] = {
+        "as", "zz t1", "as t9", "as f0", "new x", "quit now", "deal 2"
+    };
+    for (i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+        strcpy(req, bad[i]);
+        server_request(&game, req, resp);
+        ok = ok && strncmp(resp, "err ", 4) == 0;
+    }
+
+    // The same moves through field_command end on the same field
+    struct deck deck = { 0 };
+    struct field same;
+    deck_init_seeded(&deck, 3);
+    field_init(&same, &deck);
+    char const *moves[] = { "deal", "deal", "undo", "deal" };
+    for (i = 0; i < sizeof(moves) / sizeof(moves[0]); ++i) {
+        strcpy(req, moves[i]);
+        server_request(&game, req, resp);
+        ok = ok && strcmp(resp, "ok\n") == 0;
+        strcpy(req, moves[i]);
+        field_command(&same, req, true);
+    }
+    ok = ok && field_hash(&game.field) == field_hash(&same);
+
+    field_destroy(&same);
+    deck_destroy(&deck);
+    server_game_destroy(&game);
+    return ok;
+}
+
+// Plays answer "ok dead" only once the ten of spades on top of a run has gone
+// home, not while dealing the last stock card leaves it the only move
+bool
+server_answers_dead_ends(struct field *field)
+{
+    PFUNC;
+    struct server_game game = { 0 };
+    struct field_pack pack;
+    char resp[SERVER_LINE_MAX];
+    char req[32];
+
+    _run_top_pack(&pack, true);
+    deck_init_seeded(&game.deck, 1);
+    game.dealt = true;
+    game.playing = true;
+    bool ok = field_unpack(&game.field, &game.deck, &pack);
+
+    char const *reqs[][2] = {
+        { "deal", "ok\n" }, { "xs f1", "ok dead\n" }, { "undo", "ok\n" }
+    };
+    size_t i;
+    for (i = 0; ok && i < sizeof(reqs) / sizeof(reqs[0]); ++i) {
+        strcpy(req, reqs[i][0]);
+        server_request(&game, req, resp);
+        ok = strcmp(resp, reqs[i][1]) == 0;
+    }
+    server_game_destroy(&game);
+    return ok;
+}
+
+// A thawed game is the same position with the same moves left to undo
+bool
+frozen_games_thaw(struct field *field)
+{
+    PFUNC;
+    struct card_move moves[FIELD_MAX_MOVES];
+    struct field_frozen frozen;
+    struct field_pack start;
+    struct field_pack pack;
+    struct field_pack repack;
+    field_pack(field, &start);
+
+    int i;
+    for (i = 0; i < 50; ++i) {
+        int cnt = field_gen_moves(field, moves, FIELD_MAX_MOVES);
+        if (cnt == 0)
+            break;
+        field_apply_move(field, &moves[(i * 7) % cnt]);
+    }
+    int cnt = field->history.cnt;
+    uint64_t hash = field_hash(field);
+    field_pack(field, &pack);
+    field_freeze(field, &frozen);
+
+    struct deck deck = { 0 };
+    struct field thawed;
+    if (!field_thaw(&thawed, &deck, &frozen))
+        return false;
+    field_pack(&thawed, &repack);
+    bool ok = memcmp(&pack, &repack, sizeof(pack)) == 0
+        && field_hash(&thawed) == hash
+        && field_hash_compute(&thawed) == hash
+        && thawed.history.cnt == cnt
+        && frozen.actions == NULL;
+
+    // Undoing every move gets back to the deal, the first entry being it
+    while (thawed.history.cnt > 1)
+        undo_move(&thawed);
+    field_pack(&thawed, &repack);
+    ok = ok && memcmp(&start, &repack, sizeof(start)) == 0;
+
+    field_destroy(&thawed);
+    deck_destroy(&deck);
+    return ok;
+}
+
+// Percentiles come out within a sixteenth of the latencies put in
+bool
+load_hist_percentiles(struct field *field)
+{
+    PFUNC;
+    static struct load_hist hist;
+    static struct load_hist half;
+    uint64_t ns;
+    memset(&hist, 0, sizeof(hist));
+    memset(&half, 0, sizeof(half));
+    for (ns = 1; ns <= 100000; ++ns)
+        load_hist_add(ns <= 50000 ? &half : &hist, ns * 1000);
+    load_hist_merge(&hist, &half);
+
+    double ps[] = { 0, 50, 99, 99.9, 100 };
+    size_t i;
+    for (i = 0; i < sizeof(ps) / sizeof(ps[0]); ++i) {
+        double want = ps[i] < 0.001 ? 1000 : ps[i] * 1000 * 1000;
+        double got = (double)load_hist_percentile(&hist, ps[i]);
+        if (got < want || got > want * (1 + 1.0 / 16))
+            return false;
+    }
+    return hist.cnt == 100000 && hist.max == 100000 * 1000
+        && load_hist_percentile(&half, 100) == 50000 * 1000;
+}
 
 int
 run_tests(void)
 {
-    FieldTestFunc tests[4] = {
+    FieldTestFunc tests[] = {
         stock_turnover_is_in_order,
         undo_waste_15x_same_top_card,
         undo_waste_30x_same_top_card,
-        test3
+        test3,
+        piles_hold_every_card_once,
+        pack_unpack_round_trips,
+        hash_tracks_deals_and_undos,
+        recycle_restamps_lazily,
+        generated_moves_apply,
+        generated_moves_follow_rules,
+        quiet_moves_report_reasons,
+        field_search_finds_every_card,
+        solver_solution_replays,
+        solution_commands_replay,
+        seeded_decks_repeat,
+        deal_numbers_are_stable,
+        bulk_deals_match_decks,
+        simulation_repeats,
+        reset_fields_match_fresh,
+        history_copies_undo_exactly,
+        dead_end_tracks_moves,
+        waste_to_foundation_is_not_dead_end,
+        run_top_to_foundation_is_not_dead_end,
+        batch_matches_sequential,
+        render_frame_shows_deal,
+        render_screen_diffs_moves,
+        server_requests_play,
+        server_answers_dead_ends,
+        frozen_games_thaw,
+        load_hist_percentiles,
     };
+    int num_tests = sizeof(tests) / sizeof(tests[0]);
 
 
     struct deck deck = { 0 };
@@ -119,7 +1213,7 @@ run_tests(void)
     // field_sym_print(&field);
 
     int i;
-    for (i = 0; i < 4; ++i) {
+    for (i = 0; i < num_tests; ++i) {
         init_game(&field, &deck);
         if (tests[i](&field) == true)
             printf("Passed test %i\n", i + 1);